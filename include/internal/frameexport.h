@@ -0,0 +1,19 @@
+#pragma once
+
+#include "internal/framerecorder.h"
+#include "internal/paletteparser.h"
+
+#include <string>
+#include <vector>
+
+// Maps recorded frames onto the palette's nearest (Oklab) colors and writes
+// them as an animated GIF when path ends in .gif, otherwise as a sprite
+// sheet PNG with the frames packed in a square-ish grid, left to right and
+// top to bottom. delay is the GIF's time per frame, in hundredths of a
+// second. Frames must all be the same size.
+bool export_frames(
+    const std::string& path,
+    const std::vector<CapturedFrame>& frames,
+    const Palette& palette,
+    int delay
+);
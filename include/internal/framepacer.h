@@ -0,0 +1,45 @@
+#pragma once
+#include "glad/glad.h"
+
+#include <GLFW/glfw3.h>
+
+#include <deque>
+
+// Optional frame rate limiter, plus an input-to-present latency estimate:
+// each presented frame gets a fence, and once the GPU signals it the time
+// since that frame's input was sampled is recorded.
+class FramePacer {
+  public:
+    FramePacer();
+    ~FramePacer();
+
+    void setSwapInterval(int interval);
+    void setFrameLimit(double fps);
+
+    void waitForNextFrame();
+    void markInput();
+    void markPresent();
+
+  private:
+    // sleep until this close to the deadline, then spin; OS sleeps overshoot
+    static constexpr double SPIN_MARGIN = 0.002;
+    static const int MAX_PENDING_FRAMES = 4;
+    static const int REPORT_INTERVAL = 120;
+
+    struct PendingFrame {
+        GLsync fence;
+        double input_time;
+    };
+
+    double frame_interval; // 0 when unlimited
+    double next_frame_time;
+    double input_time;
+    double last_present_time;
+    std::deque<PendingFrame> pending;
+
+    double latency_total;
+    double frame_time_total;
+    int samples;
+
+    void collectFences();
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include "glad/glad.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct CapturedFrame {
+    int index; // frames since recording started, including dropped ones
+    int width;
+    int height;
+    std::vector<unsigned char> rgba; // top row first
+};
+
+// Records a framebuffer's color attachment without stalling the render
+// loop. Each capture starts an asynchronous glReadPixels into one of a ring
+// of pixel pack buffers and places a fence after it; the buffer is only
+// mapped frames later, once the fence has signalled. The copied frames go
+// to a background thread that hands them to the sink (by default, one PNG
+// per frame). If the GPU or the sink falls behind, frames are dropped and
+// counted rather than making the render loop wait, unless lossless is set.
+class FrameRecorder {
+  public:
+    using Sink = std::function<void(const CapturedFrame&)>;
+
+    FrameRecorder();
+    ~FrameRecorder();
+
+    // sink runs on the encoder thread; nullptr writes PNGs to output_dir
+    void start(Sink sink = nullptr);
+    // Finishes the readbacks in flight and everything queued, then reports.
+    void stop();
+
+    bool isRecording() const {
+        return recording;
+    }
+
+    // Call after the pass that writes framebuffer's color attachment 0.
+    void capture(GLuint framebuffer, int width, int height);
+
+    std::string output_dir;
+    // Wait for the GPU and the sink instead of dropping frames. For offline
+    // exports, where every frame matters more than the frame rate.
+    bool lossless;
+
+  private:
+    static const int RING_SIZE = 3;
+    // frames allowed to wait for the sink before new ones are dropped
+    static const int MAX_QUEUED_FRAMES = 32;
+
+    struct Readback {
+        GLuint pbo;
+        size_t capacity;
+        GLsync fence; // nullptr when the slot is free
+        int index;
+        int width;
+        int height;
+    };
+
+    Readback ring[RING_SIZE];
+    int next_slot;
+    bool recording;
+    int frame_index;
+    int dropped;
+    int written;
+
+    Sink sink;
+    std::thread encoder;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable drained; // the sink took a frame off the queue
+    std::deque<CapturedFrame> queue;
+    std::vector<std::vector<unsigned char>> free_buffers;
+    bool finishing;
+
+    void collect(bool wait);
+    void run();
+};
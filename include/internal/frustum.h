@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cy/cyMatrix.h>
+#include <cy/cyVector.h>
+
+// Six inward-facing clip planes extracted from a view-projection matrix.
+class Frustum {
+  public:
+    cyVec4f planes[6];
+
+    Frustum(const cyMatrix4f& view_projection);
+
+    bool
+    intersectsBox(const cyVec3f& bound_min, const cyVec3f& bound_max) const;
+};
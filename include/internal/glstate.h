@@ -0,0 +1,56 @@
+#pragma once
+#include "glad/glad.h"
+
+#include <vector>
+
+// Shadow copy of the binds and fixed-function state the render loop sets,
+// so a call that wouldn't change anything never reaches the driver.
+// Textures (per unit and target), the vertex array, the cull face and
+// enable caps are tracked. Programs aren't: cyGLSLProgram::SetUniform binds
+// its program itself. Code that changes tracked state behind the tracker's
+// back (creating or deleting GL objects, cy helpers that bind on their own)
+// calls invalidate() afterwards, so the next request is always issued.
+class GLStateTracker {
+  public:
+    GLStateTracker();
+
+    void activeTexture(int unit);
+    // Binds on the active unit; for creating and filling textures.
+    void bindTexture(GLenum target, GLuint texture);
+    void bindTexture(int unit, GLenum target, GLuint texture);
+    void bindVertexArray(GLuint array);
+    void cullFace(GLenum face);
+    void setEnabled(GLenum cap, bool enabled);
+
+    // Forgets everything; the next request of each kind is issued.
+    void invalidate();
+
+    // Ends a frame; every REPORT_FRAMES frames, prints the average issued
+    // and filtered calls per frame.
+    void endFrame();
+
+  private:
+    static const int REPORT_FRAMES = 120;
+    static const int MAX_UNITS = 16;
+    static const int TARGETS = 3; // 2D, buffer and 1D array textures
+    static const GLuint UNKNOWN = ~0u;
+
+    struct Capability {
+        GLenum cap;
+        bool enabled;
+    };
+
+    int active_unit; // -1 when unknown
+    GLuint textures[MAX_UNITS][TARGETS];
+    GLuint vertex_array;
+    GLenum cull_face; // 0 when unknown
+    std::vector<Capability> capabilities; // only the known ones
+
+    // since the last report
+    unsigned int issued;
+    unsigned int filtered;
+    int frames;
+};
+
+// The tracker for the window's context; everything renders on it.
+GLStateTracker& gl_state();
@@ -0,0 +1,80 @@
+#pragma once
+#include "glad/glad.h"
+
+#include <cy/cyCore.h>
+#include <cy/cyGL.h>
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// Watches shader files and rebuilds their programs on a background thread
+// with its own shared GL context. A rebuilt program replaces the live one
+// (keeping its uniform values) only once it has linked successfully, so the
+// render loop never waits on the compiler.
+class ShaderHotReloader {
+  public:
+    ShaderHotReloader(GLFWwindow* window);
+    ~ShaderHotReloader();
+
+    // Rebuilds program from vertex_path/fragment_path whenever one of
+    // watched_files changes. prepare runs on the worker before building,
+    // e.g. to regenerate a file from its template. A rebuilt program starts
+    // with no registered uniforms, so a program used with index-based
+    // SetUniform passes its RegisterUniform calls as register_uniforms;
+    // they run on the rebuilt program before it replaces the live one.
+    void watch(
+        cyGLSLProgram& program,
+        const char* vertex_path,
+        const char* fragment_path,
+        vector<string> watched_files,
+        std::function<void()> prepare = nullptr,
+        std::function<void(cyGLSLProgram&)> register_uniforms = nullptr
+    );
+
+    void start();
+
+    // Installs rebuilt programs. Call from the render thread.
+    void apply();
+
+  private:
+    static constexpr int POLL_INTERVAL_MS = 250;
+
+    struct WatchEntry {
+        cyGLSLProgram& program;
+        string vertex_path;
+        string fragment_path;
+        vector<string> watched_files;
+        std::function<void()> prepare;
+        std::function<void(cyGLSLProgram&)> register_uniforms;
+        vector<std::filesystem::file_time_type> last_write;
+    };
+
+    struct ReadyProgram {
+        cyGLSLProgram& target;
+        std::unique_ptr<cyGLSLProgram> program;
+        std::function<void(cyGLSLProgram&)> register_uniforms;
+    };
+
+    GLFWwindow* shared_context;
+    vector<WatchEntry> entries;
+
+    std::thread worker;
+    std::atomic<bool> stopping;
+    std::mutex mutex;
+    std::condition_variable wake;
+    vector<ReadyProgram> ready;
+
+    void run();
+    bool hasChanged(WatchEntry& entry);
+};
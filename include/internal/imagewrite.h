@@ -0,0 +1,39 @@
+#pragma once
+
+#include "internal/paletteparser.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Both take rows top first and print the lodepng error on failure.
+
+bool write_rgba_png(
+    const std::string& path,
+    const unsigned char* rgba,
+    int width,
+    int height
+);
+
+// Writes palette indices as an indexed (LCT_PALETTE) PNG using the
+// palette's sRGB colors in file order, at the smallest bit depth that holds
+// them.
+bool write_indexed_png(
+    const std::string& path,
+    const uint8_t* indices,
+    int width,
+    int height,
+    const Palette& palette
+);
+
+// Writes an animated, endlessly looping GIF89a. Each frame is width * height
+// palette indices (rows top first); frames are LZW-compressed in parallel
+// and then written in order. delay is per frame, in hundredths of a second.
+bool write_indexed_gif(
+    const std::string& path,
+    const std::vector<std::vector<uint8_t>>& frames,
+    int width,
+    int height,
+    const Palette& palette,
+    int delay
+);
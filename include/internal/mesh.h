@@ -2,26 +2,96 @@
 #include "glad/glad.h"
 #include <cy/cyCore.h>
 #include <cy/cyGL.h>
+#include <cy/cyMatrix.h>
 
 #include "internal/spotlight.h"
-#include "internal/rendering.h"
+#include "internal/meshlod.h"
+
+// ivec2 vertex attribute the mesh and shadow shaders take their transform
+// node and material index from
+const GLuint DRAW_ATTRIBUTE = 3;
 
 struct MeshData {
     GLuint VAO;
     GLuint VBO;
     GLuint EBO;
-    int unsigned numFaces;
-    cyTriMesh mesh;
+    // tightly packed positions for depth-only passes, drawn with the same
+    // EBO
+    GLuint depth_VAO;
+    GLuint position_VBO;
+    MeshLOD lods[MAX_LODS];
+    int lod_count;
+    cyVec3f bound_min;
+    cyVec3f bound_max;
+};
+
+struct MaterialData {
+    cyVec3f diffuse; // Kd
+    cyVec3f specular; // Ks
+    cyVec3f ambient; // Ka
+    float shine; // Ns
+    GLuint diffuse_texture;
+    GLuint specular_texture;
+};
+
+// default gooch shading constants, used unless a scene material sets its own
+const cyVec3f GOOCH_COOL = cyVec3f(64.0, 6.0, 191.0) / 255.0;
+const cyVec3f GOOCH_WARM = cyVec3f(255.0, 223.0, 97.0) / 255.0;
+const float GOOCH_ALPHA = 0.6;
+const float GOOCH_BETA = 0.2;
+
+// Gooch shading tones. The warm/cool colors are converted to Oklab once here
+// instead of in every fragment.
+struct GoochTones {
+    cyVec3f cool_oklab;
+    cyVec3f warm_oklab;
+    float alpha; // how much albedo blends into the cool tone
+    float beta; // how much albedo blends into the warm tone
+
+    GoochTones(cyVec3f cool_rgb, cyVec3f warm_rgb, float alpha, float beta);
 };
 
+// One placement of a mesh in the scene. Meshes made from the same OBJ share
+// its buffers, which the scene owns.
 class Mesh {
   public:
     struct MeshData mesh_data;
+    MaterialData material;
+    int transform; // node in the scene's TransformArray
+    int material_index; // entry in the scene's material table
+    // mesh_data's bounds in world space, kept by updateBounds
+    cyVec3f bound_min;
+    cyVec3f bound_max;
     bool casts_shadow;
+    GoochTones gooch;
+
+    Mesh(
+        MeshData mesh_data,
+        MaterialData material,
+        int transform,
+        int material_index,
+        bool casts_shadow,
+        GoochTones gooch
+    );
+
+    void updateBounds(const cyMatrix4f& world);
+
+    // The coarsest level of detail whose error stays within max_error
+    // pixels on a target viewport_height pixels tall, seen through
+    // view_projection.
+    int selectLOD(
+        const cyMatrix4f& view_projection,
+        float viewport_height,
+        float max_error
+    ) const;
 
-    Mesh(MeshData mesh_data, bool casts_shadow);
+    void draw(int lod);
+    // Draws through the position-only arrays, for the shadow pass.
+    void drawDepth(int lod);
+    // Sets the transform node and material for the next draw.
+    void bindDraw();
+    void bindTextures();
 
-    void draw();
-    void bindMaterialProperties(cyGLSLProgram& program);
-    void cleanup();
+  private:
+    void drawElements(int lod);
 };
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+const int MAX_LODS = 4;
+
+// One level of detail: a range of the mesh's element buffer. All levels
+// index the same vertex buffer, finest first.
+struct MeshLOD {
+    unsigned int first_index;
+    unsigned int index_count;
+    // roughly how far the simplified surface strays from the original, in
+    // model units; 0 for the full mesh
+    float error;
+};
+
+struct LODIndices {
+    std::vector<unsigned int> indices;
+    float error;
+};
+
+// Simplifies an indexed triangle mesh by quadric error edge collapse
+// (Garland and Heckbert), each level keeping about a quarter of the
+// previous one's triangles. A vertex only ever collapses onto a neighbour,
+// so surviving vertices keep their normals and texture coordinates, and
+// vertices on open borders or texture seams (positions shared by several
+// vertices) stay put. Returns the full mesh first, then up to MAX_LODS - 1
+// coarser levels; fewer when the mesh is small or won't reduce further.
+// vertices holds stride floats per vertex, the position first.
+std::vector<LODIndices> build_lods(
+    const std::vector<float>& vertices,
+    int stride,
+    const std::vector<unsigned int>& indices
+);
+
+// build_lods through ./mesh_cache, keyed by the vertex and index data, so
+// each mesh is only simplified once. Safe to call from worker threads for
+// different meshes.
+std::vector<LODIndices> load_lods(
+    const std::string& obj_path,
+    const std::vector<float>& vertices,
+    int stride,
+    const std::vector<unsigned int>& indices
+);
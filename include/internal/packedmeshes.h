@@ -0,0 +1,60 @@
+#pragma once
+#include "glad/glad.h"
+
+#include "internal/mesh.h"
+
+#include <vector>
+
+// Every scene mesh copied into one shared vertex buffer and one shared index
+// buffer, each mesh in its own sub-range. A pass binds a single VAO and
+// submits all its visible meshes with one glMultiDrawElementsBaseVertex per
+// texture pair (one in total for the shadow pass) instead of a bind and a
+// draw per mesh. GL 4.1 has neither multi-draw indirect nor gl_DrawID, so
+// each vertex carries its mesh's transform node and material itself; a mesh
+// placed several times is copied once per placement.
+class PackedMeshes {
+  public:
+    // Reads the geometry back from the meshes' own buffers.
+    PackedMeshes(const std::vector<Mesh>& meshes);
+    ~PackedMeshes();
+
+    // Draws level lods[i] of meshes[i] for every i in visible. by_texture
+    // binds each mesh's textures (color pass); otherwise everything goes in
+    // one call through the position-only arrays (shadow pass).
+    void draw(
+        const std::vector<int>& visible,
+        const std::vector<int>& lods,
+        bool by_texture
+    );
+
+    size_t memoryBytes() const {
+        return bytes;
+    }
+
+  private:
+    struct Range {
+        MeshLOD lods[MAX_LODS]; // first_index is into the shared buffer
+        GLint base_vertex;
+        int texture_group; // meshes with the same two textures share one
+        GLuint diffuse_texture;
+        GLuint specular_texture;
+    };
+
+    GLuint VAO;
+    GLuint VBO;
+    GLuint draw_VBO; // transform node and material per vertex
+    GLuint EBO;
+    // positions only, with draw_VBO and EBO, for the shadow pass
+    GLuint depth_VAO;
+    GLuint position_VBO;
+    size_t bytes;
+    std::vector<Range> ranges;
+
+    // reused between calls
+    std::vector<int> order;
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    std::vector<GLint> base_vertices;
+
+    void submit();
+};
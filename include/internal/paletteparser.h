@@ -1,12 +1,75 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
 using std::string;
 
+// An RGB or Oklab (x = L, y = a, z = b) color.
+struct Color3f {
+    float x, y, z;
+};
+
+Color3f oklab_from_rgb(Color3f rgb);
+
+// Same conversion with fast_cbrtf; for bulk per-pixel work.
+Color3f oklab_from_rgb_fast(Color3f rgb);
+
+float fast_cbrtf(float x);
+
+// sRGB transfer function through lookup tables, built on first use.
+float linear_from_srgb8(uint8_t encoded);
+uint8_t srgb8_from_linear(float linear);
+
+// A loaded palette; srgb and oklab hold one entry per color in file order.
+struct Palette {
+    std::vector<std::array<uint8_t, 3>> srgb;
+    std::vector<Color3f> oklab;
+    // indices into srgb/oklab from darkest to lightest (Oklab L)
+    std::vector<uint32_t> by_lightness;
+
+    size_t size() const {
+        return srgb.size();
+    }
+
+    void clear();
+};
+
+// Reads palettes in any of these formats:
+// - .hex / Paint.NET .txt: one RRGGBB, #RRGGBB or AARRGGBB per line,
+//   ';' comments
+// - GIMP .gpl: "GIMP Palette" header, then "R G B [name]" lines
+// - JASC .pal: "JASC-PAL", version, count, then "R G B" lines
+// - .png: a swatch strip; each distinct opaque color in scan order
+// Text formats are told apart by their header rather than the extension.
+// A parser keeps its read buffer and the output keeps its capacity, so
+// loading many palettes in a row doesn't allocate per file or per line.
 class PaletteParser {
   public:
-    static string generate_code_insert(const std::string& filename);
+    // Returns false with a "path: line N: reason" message in error instead
+    // of exiting; out is left empty then. linear_rgb decodes the sRGB values
+    // before converting to Oklab, to match targets sampled as linear (--srgb).
+    bool load(
+        const string& path,
+        bool linear_rgb,
+        Palette& out,
+        string& error
+    );
+
+    // GLSL declaring the palette's Oklab colors as the PALETTE constant.
+    static bool generate_code_insert(
+        const string& path,
+        bool linear_rgb,
+        string& code,
+        string& error
+    );
 
   private:
-    std::ifstream file;
+    string buffer;
+
+    bool parseText(std::string_view text, Palette& out, string& error);
+    bool parsePng(const string& path, Palette& out, string& error);
 };
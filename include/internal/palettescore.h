@@ -0,0 +1,56 @@
+#pragma once
+
+#include "internal/paletteparser.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// An image prepared for scoring. Pixels index into a table of unique colors
+// and neighbouring pixel pairs are merged by color, so the cost of scoring a
+// palette depends on how many distinct colors and transitions the image has
+// rather than on its resolution.
+struct ScoringReference {
+    struct Pair {
+        uint32_t a, b; // indices into colors
+        uint32_t count;
+        float delta_e; // Oklab distance between a and b
+    };
+
+    int width;
+    int height;
+    std::vector<Color3f> colors; // unique Oklab colors
+    std::vector<uint32_t> counts; // pixels per unique color
+    std::vector<Pair> smooth_pairs; // neighbours closer than a visible step
+    std::vector<Pair> edge_pairs; // neighbours across a clear edge
+
+    // rgba: width * height * 4 bytes. linear_rgb decodes sRGB first (--srgb).
+    ScoringReference(
+        const unsigned char* rgba,
+        int width,
+        int height,
+        bool linear_rgb
+    );
+};
+
+struct PaletteScore {
+    std::string path;
+    double mean_delta_e; // average Oklab error after palettization
+    double banding; // average step introduced between smooth neighbours
+    double edge_preservation; // fraction of edge contrast kept, 0 to 1
+    double cost; // weighted combination; lower ranks first
+};
+
+// Palette files (.hex, .txt, .gpl, .pal, .png) directly inside dir, sorted
+// by name.
+std::vector<std::string> list_palette_files(const std::string& dir);
+
+// Scores every palette against the reference on all cores and returns them
+// ranked best first.
+std::vector<PaletteScore> score_palettes(
+    const ScoringReference& reference,
+    const std::vector<std::string>& palette_paths,
+    bool linear_rgb
+);
+
+void print_palette_ranking(const std::vector<PaletteScore>& scores);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// How many threads parallel_for runs count items on.
+inline size_t parallel_thread_count(size_t count) {
+    return std::min<size_t>(
+        count,
+        std::max(1u, std::thread::hardware_concurrency())
+    );
+}
+
+// Calls body(state, i) for every i in [0, count) on all hardware threads,
+// the calling thread included, with one default-constructed State per
+// thread for scratch data worth reusing between items. Items are handed out
+// one at a time, so uneven work balances itself.
+template<typename State, typename Body>
+void parallel_for(size_t count, Body body) {
+    std::atomic<size_t> next(0);
+    auto work = [&] {
+        State state;
+        for (size_t i = next++; i < count; i = next++) {
+            body(state, i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < parallel_thread_count(count); t++) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+// Same, for bodies that need no per-thread state: body(i).
+template<typename Body>
+void parallel_for(size_t count, Body body) {
+    struct NoState {};
+    parallel_for<NoState>(count, [&](NoState&, size_t i) { body(i); });
+}
@@ -5,23 +5,47 @@
 #include <cy/cyCore.h>
 #include <cy/cyGL.h>
 #include "internal/scene.h"
+#include "internal/paletteparser.h"
+#include "internal/framerecorder.h"
 
 #include <GLFW/glfw3.h>
 
+#include <vector>
+
+// How the post-processed image reaches the default framebuffer.
+enum class UpscaleBackend {
+    // outline/palette pass into outline_texture_ID, then glBlitFramebuffer
+    Blit,
+    // outline/palette pass into outline_texture_ID, then upscale.frag
+    Shader,
+    // outline/palette pass evaluated per canvas pixel, written directly
+    Fused,
+};
+
+const char* upscale_backend_name(UpscaleBackend backend);
+
 class PixelArtEffect {
   private:
     GLuint downscale_framebuffer_ID;
     GLuint downscale_texture_ID;
+    GLuint linear_depth_texture_ID;
     GLuint outline_framebuffer_ID;
     GLuint outline_texture_ID;
     GLuint rbo_ID;
     int width;
     int height;
+    // size at downscale_factor, which dynamic resolution doesn't change
+    int base_width;
+    int base_height;
+    // allocated size of the render targets; width/height is the sub-viewport
+    // actually rendered into, so resolution changes don't reallocate
+    int capacity_width;
+    int capacity_height;
     GLFWwindow* window;
 
   public:
-    cyGLSLProgram outline_program;
-    cyGLSLProgram upscale_program;
+    cyGLSLProgram& outline_program;
+    cyGLSLProgram& upscale_program;
 
   private:
     Scene& scene;
@@ -29,18 +53,76 @@ class PixelArtEffect {
     // Simple quad for drawing the texture
     unsigned int quadVAO, quadVBO;
 
+    // GPU timings of endRender, read back a frame late to avoid stalls
+    static const int TIMER_REPORT_INTERVAL = 120;
+    GLuint timer_queries[2];
+    int timer_index;
+    bool timer_pending[2];
+    GLuint64 timer_total_ns;
+    int timer_samples;
+
+    UpscaleBackend upscale_backend;
+
+    // --srgb: color targets are GL_SRGB8_ALPHA8, so the post-process reads
+    // linear RGB and its writes are encoded again by GL_FRAMEBUFFER_SRGB
+    bool srgb;
+    // whether the default framebuffer encodes on write; if not, the
+    // shaders writing to it encode in ALU instead
+    bool canvas_srgb;
+
+    // Multi-palette batch: one palette pass per layer of
+    // batch_palette_texture_ID, each into its own tile of the atlas, all
+    // reading the same scene render.
+    GLuint batch_palette_texture_ID;
+    std::vector<Palette> batch_palettes;
+    GLuint atlas_framebuffer_ID;
+    GLuint atlas_texture_ID;
+    GLuint atlas_index_texture_ID; // GL_R8UI, written by indexed captures
+    int atlas_width;
+    int atlas_height;
+    GLuint batch_query;
+    bool batch_requested;
+
     void createFramebuffer(int w, int h);
+    void createAtlas(int w, int h);
+    void renderPaletteBatch();
+    bool saveAtlas();
+    bool saveIndexedTiles(int columns, int rows);
+    GLenum colorFormat() const;
+    void setSRGBWrites(bool enabled);
     void setupQuad();
+    void updateUVScale();
+    void bindPostProcessInputs();
+    void drawOutline();
+    void drawUpscale();
+    void blitUpscale();
+    void drawFused();
+    void collectTiming();
+    void reportMemory() const;
+
+    // size of the upscaled image on the canvas
+    int output_width;
+    int output_height;
 
   public:
+    // resolution divisor chosen by the user
     int downscale_factor;
+    // divisor actually rendered at; equals downscale_factor unless the
+    // ResolutionController is adjusting it
+    float render_scale;
+    // batch captures keep palette indices end to end and save one indexed
+    // PNG per palette instead of an RGBA atlas
+    bool indexed_output;
+    // records the low-res outline target (before upscaling) while running
+    FrameRecorder recorder;
 
     PixelArtEffect(
         GLFWwindow* window,
         int downscale_factor,
         cyGLSLProgram& outline_program,
         cyGLSLProgram& upscale_program,
-        Scene& scene
+        Scene& scene,
+        bool srgb
     );
     ~PixelArtEffect();
 
@@ -48,6 +130,24 @@ class PixelArtEffect {
     void beginRender();
     void endRender();
 
+    void setUpscaleBackend(UpscaleBackend backend);
+
+    // Palettes evaluated by a batch capture.
+    void setBatchPalettes(const std::vector<Palette>& palettes);
+    // On the next endRender, run the palette pass once per batch palette
+    // and save the tiles to ./palette_batch.png.
+    void requestPaletteBatch();
+
+    // This frame's scene before outlines and palette matching, as
+    // GetWidth() * GetHeight() RGBA bytes, bottom row first.
+    std::vector<unsigned char> readSceneColor();
+
+    size_t memoryBytes() const;
+
+    UpscaleBackend GetUpscaleBackend() const {
+        return upscale_backend;
+    }
+
     int GetWidth() const {
         return width;
     }
@@ -55,4 +155,12 @@ class PixelArtEffect {
     int GetHeight() const {
         return height;
     }
+
+    int GetBaseWidth() const {
+        return base_width;
+    }
+
+    int GetBaseHeight() const {
+        return base_height;
+    }
 };
@@ -14,8 +14,6 @@
 
 using std::string;
 
-struct MaterialData {};
-
 struct ShaderPrograms {
     cyGLSLProgram mesh;
     cyGLSLProgram shadow;
@@ -25,14 +23,29 @@ struct ShaderPrograms {
 
 ShaderPrograms build_programs();
 
-struct MeshData load_mesh(cyGLSLProgram& prog, char* path);
+// An OBJ read into interleaved vertex data, without touching GL, so several
+// can be read at once on worker threads.
+struct MeshAsset {
+    std::vector<float> vertices; // position, normal, texture coordinate
+    std::vector<unsigned int> indices; // every level of detail in turn
+    std::vector<MeshLOD> lods;
+    cyVec3f bound_min;
+    cyVec3f bound_max;
+    MaterialData material; // the first MTL material; textures not loaded
+    string diffuse_map; // resolved against the OBJ's directory, or empty
+    string specular_map;
+};
+
+// Returns false with a reason in error instead of exiting. Levels of detail
+// come from ./mesh_cache, or are generated (and cached) on first use.
+bool read_mesh_asset(const string& path, MeshAsset& out, string& error);
+
+struct MeshData upload_mesh_asset(cyGLSLProgram& prog, const MeshAsset& asset);
+
+// RGBA8 with mipmaps and repeat wrapping; returns the texture ID.
+GLuint
+upload_texture(const unsigned char* rgba, unsigned width, unsigned height);
 
-void load_texture(
-    cyGLSLProgram& prog,
-    std::basic_string<char> filepath,
-    char* attrib_name,
-    unsigned tex_id
-);
+size_t texture_bytes(GLenum internal_format, int width, int height);
 
-struct MeshData
-bind_mesh_vertex_attributes(cyGLSLProgram& prog, cyTriMesh& mesh);
+void print_target_memory(const char* name, size_t bytes);
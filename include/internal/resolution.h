@@ -0,0 +1,44 @@
+#pragma once
+#include "glad/glad.h"
+
+#include "internal/pixelartfx.h"
+
+// Dynamic resolution: watches GPU frame time and nudges the effect's
+// render_scale in fractional steps to stay within a frame time budget.
+class ResolutionController {
+  public:
+    bool enabled;
+    double target_frame_ms;
+
+    ResolutionController(double target_frame_ms);
+    ~ResolutionController();
+
+    void beginFrame();
+    // Picks render_scale for the frame about to be rendered, from the frame
+    // times read so far and the current downscale_factor. Called after
+    // input handling and before setFramebufferSize, so a change takes effect
+    // on the same frame.
+    void applyScale(PixelArtEffect& pixel_effect);
+    void endFrame();
+
+  private:
+    static constexpr float SCALE_STEP = 0.25f;
+    // coarsest scale allowed, relative to the user's downscale_factor
+    static constexpr float MAX_SCALE_RATIO = 2.0f;
+    // hysteresis band around the target, and frames to wait between steps
+    static constexpr double OVER_BUDGET = 1.05;
+    static constexpr double UNDER_BUDGET = 0.80;
+    static constexpr int SETTLE_FRAMES = 30;
+    static constexpr double SMOOTHING = 0.1;
+
+    // GL_TIMESTAMP pairs, read back a frame late to avoid stalls
+    GLuint timestamp_queries[2][2];
+    bool query_pending[2];
+    int query_index;
+
+    float scale;
+    double average_frame_ms;
+    int frames_since_change;
+
+    bool readFrameTime(double& frame_ms);
+};
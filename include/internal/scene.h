@@ -5,21 +5,105 @@
 
 #include "internal/spotlight.h"
 #include "internal/rendering.h"
+#include "internal/frustum.h"
+#include "internal/transforms.h"
+#include "internal/packedmeshes.h"
 
+#include <memory>
+#include <string>
 #include <vector>
+using std::string;
 using std::vector;
 
 class Scene {
   public:
     SpotLight light;
+    // the scene file placed the light, so it isn't animated
+    bool light_fixed;
     vector<Mesh> meshes;
+    TransformArray transforms; // one node per mesh, in scene file order
     ShaderPrograms& programs;
-    cyGLRenderDepth2D depth_texture;
+    cyMatrix4f view_projection; // camera, set by update_camera each frame
 
-    Scene(ShaderPrograms& programs, GLFWwindow* window);
+    // 0 sizes the shadow map from the render resolution every frame
+    unsigned int fixed_shadow_size;
+    GLenum shadow_depth_format;
+
+    // pick each mesh's level of detail per pass; off draws full detail
+    // (--no-lod)
+    bool use_lods;
+
+    // meshes skipped by frustum culling during the last frame
+    unsigned int shadow_culled;
+    unsigned int color_culled;
+
+    // Exits with a message if the scene file or one of its assets fails to
+    // load.
+    Scene(
+        ShaderPrograms& programs,
+        GLFWwindow* window,
+        const string& scene_path
+    );
     ~Scene();
 
+    // Turns spinning meshes to where they are at seconds, then brings
+    // moved transforms and their meshes' bounds up to date on the GPU.
+    void animate(double seconds);
+
+    // Uploads meshes[mesh]'s material and Gooch tones again after they
+    // change; the shaders read them from a table filled at load.
+    void updateMaterial(int mesh);
+
+    // Copies every mesh into shared buffers and from then on submits each
+    // pass with multi-draws (--packed-draws).
+    void enablePackedDraws();
+
+    // Sizes the shadow map for the base (downscale_factor) resolution, so
+    // dynamic resolution steps don't reallocate it, and records the height
+    // actually rendered at for picking levels of detail.
+    void fitShadowMap(int base_width, int base_height, int render_height);
+
     void drawShadowMap();
 
     void drawMeshes();
+
+  private:
+    // GL objects shared between meshes, deleted once each
+    vector<MeshData> buffers;
+    vector<GLuint> textures;
+    // four RGBA32F texels per mesh, read by mesh.vert
+    GLuint material_buffer;
+    GLuint material_texture;
+
+    std::unique_ptr<PackedMeshes> packed;
+    vector<int> visible; // reused by both passes
+    vector<int> lods; // level of detail per mesh in the current pass
+    int render_height; // of the downscaled target, from fitShadowMap
+
+    // CPU time spent culling and submitting draws and the triangles drawn
+    // per pass, summed since the last periodic report
+    double submit_ms;
+    double shadow_triangles;
+    double color_triangles;
+    int submit_frames;
+
+    struct Spin {
+        int node;
+        cyVec3f rotation; // at time 0
+        float speed; // radians per second about Z
+    };
+    vector<Spin> spins;
+
+    void load(const string& path);
+    // Picks meshes[i]'s level for this pass into lods[i] and returns its
+    // triangle count.
+    unsigned int chooseLOD(
+        int i,
+        const cyMatrix4f& view_projection,
+        float height,
+        float max_error
+    );
+    void reportSubmitTime(double color_pass_ms);
+    void
+    reportCulling(const char* pass, unsigned int& count, unsigned int n);
 };
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cy/cyVector.h>
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using std::string;
+
+// Overrides for an OBJ's own (first) material. Unset fields keep the MTL's
+// value.
+struct SceneMaterial {
+    std::optional<cyVec3f> diffuse;
+    std::optional<cyVec3f> specular;
+    std::optional<float> shine;
+    std::optional<string> diffuse_map;
+    std::optional<string> specular_map;
+    // Gooch tones (see GoochTones); unset ones keep the defaults
+    std::optional<cyVec3f> cool;
+    std::optional<cyVec3f> warm;
+    std::optional<float> alpha;
+    std::optional<float> beta;
+};
+
+struct SceneMesh {
+    string obj_path;
+    string material; // empty for the OBJ's own
+    string name; // for other meshes to name as their parent
+    int parent = -1; // index of an earlier mesh this one moves with
+    cyVec3f position = cyVec3f(0, 0, 0);
+    cyVec3f rotation = cyVec3f(0, 0, 0); // radians about X, then Y, then Z
+    float scale = 1;
+    float spin = 0; // radians per second about Z
+    bool casts_shadow = true;
+};
+
+// A scene description, one statement per line; '#' starts a comment.
+//   camera distance D orbit DEGREES tilt DEGREES
+//   light position X Y Z target X Y Z fov F
+//   material NAME [diffuse R G B] [specular R G B] [shine N]
+//            [diffuse_map PATH] [specular_map PATH]
+//            [cool R G B] [warm R G B] [alpha A] [beta B]
+//   mesh PATH [name NAME] [parent NAME] [material NAME] [position X Y Z]
+//        [rotation X Y Z] [scale S] [spin DEGREES_PER_SECOND]
+//        [shadow on|off]
+// Every statement but mesh is optional. Without a light position the light
+// circles its target; with one it stays put. A mesh with a parent is placed
+// relative to it, and the parent must be listed first. Paths are relative
+// to the scene file and are stored resolved, so the scene can be loaded
+// from anywhere.
+struct SceneFile {
+    std::optional<float> camera_distance;
+    std::optional<float> camera_orbit; // radians
+    std::optional<float> camera_tilt; // radians
+
+    std::optional<cyVec3f> light_position;
+    std::optional<cyVec3f> light_target;
+    std::optional<float> light_fov;
+
+    std::unordered_map<string, SceneMaterial> materials;
+    std::vector<SceneMesh> meshes;
+
+    // Returns false with a "path: line N: reason" message in error.
+    bool load(const string& path, string& error);
+};
@@ -0,0 +1,13 @@
+#pragma once
+#include "glad/glad.h"
+
+#include <cy/cyCore.h>
+#include <cy/cyGL.h>
+
+// Builds a program from a vertex/fragment shader pair, reusing a linked
+// binary from ./shader_cache when the sources and driver are unchanged.
+bool build_program_cached(
+    cyGLSLProgram& prog,
+    const char* vertex_path,
+    const char* fragment_path
+);
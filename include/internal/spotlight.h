@@ -12,6 +12,7 @@ class SpotLight {
     cyVec3f origin, lookat;
     float fov;
     uint width, height;
+    GLenum depth_format;
 
   private:
     cyGLSLProgram& shadow_program;
@@ -28,9 +29,14 @@ class SpotLight {
         cyGLSLProgram& shadow_program,
         cyGLSLProgram& mesh_program,
         uint width,
-        uint height
+        uint height,
+        GLenum depth_format
     );
 
+    void resize(uint width, uint height, GLenum depth_format);
+
+    size_t memoryBytes() const;
+
     void Bind();
 
     void Unbind();
@@ -41,5 +47,7 @@ class SpotLight {
 
     cyMatrix4f getLightSpaceMatrix() const;
 
+    cyMatrix4f getViewProjection() const;
+
     void updateUniforms();
 };
@@ -0,0 +1,69 @@
+#pragma once
+#include "glad/glad.h"
+
+#include <cy/cyMatrix.h>
+#include <cy/cyVector.h>
+
+#include <cstdint>
+#include <vector>
+
+// Placement of every node in the scene as parallel arrays, one element per
+// node. A node's parent always comes before it, so a single forward pass
+// brings the whole hierarchy up to date, and only nodes that moved (or
+// whose parent did) recompute their world matrix. The world matrices are
+// mirrored in a texture buffer the vertex shaders read by node index; an
+// upload only covers the range that changed.
+class TransformArray {
+  public:
+    static const int NO_PARENT = -1;
+
+    TransformArray();
+    ~TransformArray();
+
+    // parent must already exist, or be NO_PARENT. Returns the node index.
+    int add(int parent, cyVec3f position, cyVec3f rotation, float scale);
+
+    void setPosition(int node, cyVec3f position);
+    void setRotation(int node, cyVec3f rotation); // radians, X then Y then Z
+    void setScale(int node, float scale);
+
+    // Recomputes moved nodes and their descendants; returns how many.
+    int update();
+    // Copies the world matrices update() changed to the GPU.
+    void upload();
+
+    const cyMatrix4f& world(int node) const {
+        return worlds[node];
+    }
+
+    // whether the last update() moved this node
+    bool moved(int node) const {
+        return changed[node];
+    }
+
+    size_t size() const {
+        return parents.size();
+    }
+
+    // samplerBuffer of RGBA32F texels, four columns per node
+    GLuint getTextureID() const {
+        return texture;
+    }
+
+  private:
+    std::vector<int> parents;
+    std::vector<cyVec3f> positions;
+    std::vector<cyVec3f> rotations;
+    std::vector<float> scales;
+    std::vector<cyMatrix4f> worlds;
+    std::vector<uint8_t> dirty; // local transform set since the last update
+    std::vector<uint8_t> changed; // world recomputed by the last update
+
+    // world matrices not yet uploaded: [upload_begin, upload_end)
+    size_t upload_begin;
+    size_t upload_end;
+
+    GLuint buffer;
+    GLuint texture;
+    size_t capacity; // nodes the buffer has room for
+};
@@ -8,14 +8,26 @@
 #include <cy/cyVector.h>
 #include <cy/cyMatrix.h>
 #include "internal/pixelartfx.h"
+#include "internal/resolution.h"
+#include "internal/scenefile.h"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 
-GLFWwindow* initAndCreateWindow();
+GLFWwindow* initAndCreateWindow(bool srgb);
 
-void process_input(GLFWwindow* window, PixelArtEffect& pixel_art_effect);
+void process_input(
+    GLFWwindow* window,
+    PixelArtEffect& pixel_art_effect,
+    ResolutionController& resolution
+);
 
-void update_camera(GLFWwindow* window, ShaderPrograms& programs);
+cyMatrix4f update_camera(GLFWwindow* window, ShaderPrograms& programs);
+
+// Turns the camera around the model, as dragging horizontally does.
+void orbit_camera(float radians);
+
+// Applies the camera settings the scene file gives.
+void place_camera(const SceneFile& scene);
 
 cyMatrix4f model_view(cyVec3f translation, float pitch, float yaw, float roll);
 
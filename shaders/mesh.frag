@@ -1,6 +1,7 @@
 #version 410 core
 
 layout(location = 0) out vec4 color;
+layout(location = 1) out float linear_depth; // read by the outline pass
 
 in vec3 Normal;
 in vec2 TexCoord;
@@ -8,20 +9,24 @@ in vec4 LightViewPosition;
 in vec3 FragPosition;
 in mat3 NormalMatrix;
 
+flat in vec3 BaseColor;
+flat in vec3 SpecularColor;
+flat in float Shine;
+
+// gooch shading tones, per material (see GoochTones in mesh.h)
+flat in vec3 CoolOklab;
+flat in vec3 WarmOklab;
+flat in float GoochAlpha;
+flat in float GoochBeta;
+
 uniform vec3 LightPosition;
-uniform vec3 BaseColor;
-uniform vec3 SpecularColor;
 uniform sampler2D DiffuseTexture;
 uniform sampler2D SpecularTexture;
 uniform sampler2DShadow ShadowMap;
-uniform float Shine;
 uniform float LightConeAngle;
+uniform float NearPlane;
+uniform float FarPlane;
 
-// gooch shading constants
-const vec3 K_COOL = vec3(64.0, 6.0, 191.0) / 255.0;
-const vec3 K_WARM = vec3(255.0, 223.0, 97.0) / 255.0;
-const float ALPHA = 0.6;
-const float BETA = 0.2;
 const float FRESNEL_SCALE = 0.3;
 
 const vec3 VIEW_DIR = vec3(0.0, 0.0, 1.0);
@@ -45,6 +50,7 @@ float distance_squared(vec3 p1, vec3 p2);
 float degrees_between(vec3 u, vec3 v);
 
 vec3 oklab_from_rgb(vec3 rgb);
+vec3 cbrt_fast(vec3 x);
 vec3 rgb_from_oklab(vec3 oklab);
 
 void main() {
@@ -54,6 +60,9 @@ void main() {
 
     vec3 shaded_color = gooch_shade(spotlight, k_d, k_s, normalize(Normal));
     color = vec4(shaded_color, 1);
+
+    linear_depth = (2.0 * NearPlane)
+            / (FarPlane + NearPlane - gl_FragCoord.z * (FarPlane - NearPlane));
 }
 
 // LIGHTING FUNCTIONS
@@ -81,8 +90,8 @@ vec3 gooch_shade(LightData light, vec3 albedo, vec3 specular, vec3 normal) {
 
     // oklab produces more natural color interpolations
     vec3 albedo_oklab = oklab_from_rgb(albedo);
-    vec3 k_cool = mix(oklab_from_rgb(K_COOL), albedo_oklab, ALPHA); // TODO: precompute K_COOL/K_WARM oklabs once
-    vec3 k_warm = mix(oklab_from_rgb(K_WARM), albedo_oklab, BETA);
+    vec3 k_cool = mix(CoolOklab, albedo_oklab, GoochAlpha);
+    vec3 k_warm = mix(WarmOklab, albedo_oklab, GoochBeta);
     vec3 gooch_diffuse = gooch * k_warm + (1 - gooch) * k_cool;
     gooch_diffuse = rgb_from_oklab(gooch_diffuse);
 
@@ -140,7 +149,7 @@ vec3 oklab_from_rgb(vec3 rgb) {
 
     vec3 lms = im1 * rgb;
 
-    return im2 * (sign(lms) * pow(abs(lms), vec3(1.0 / 3.0)));
+    return im2 * cbrt_fast(lms);
 }
 
 vec3 rgb_from_oklab(vec3 oklab) {
@@ -156,3 +165,14 @@ vec3 rgb_from_oklab(vec3 oklab) {
 
     return m2 * (lms * lms * lms);
 }
+
+// Cube root from an exponent-dividing bit trick plus one Halley step; within
+// 6e-5 Oklab distance of pow(x, 1/3) over the sRGB cube. The clamp keeps
+// y^3 out of denormals (flushed to zero on GPUs) for black inputs.
+vec3 cbrt_fast(vec3 x) {
+    vec3 a = max(abs(x), vec3(1e-18));
+    vec3 y = uintBitsToFloat(floatBitsToUint(a) / 3u + 0x2a5137a0u);
+    vec3 y3 = y * y * y;
+    y *= (y3 + 2.0 * a) / (2.0 * y3 + a);
+    return sign(x) * y;
+}
@@ -3,6 +3,9 @@
 layout(location = 0) in vec3 VertexPosition;
 layout(location = 1) in vec3 VertexNormal;
 layout(location = 2) in vec2 VertexTexCoord;
+// transform node and material; per vertex when meshes are packed into
+// shared buffers, otherwise set once per draw
+layout(location = 3) in ivec2 VertexDraw;
 
 out vec3 Normal;
 out vec2 TexCoord;
@@ -10,18 +13,58 @@ out vec4 LightViewPosition;
 out vec3 FragPosition;
 out mat3 NormalMatrix;
 
+// the draw's material, read once per vertex instead of set per draw
+flat out vec3 BaseColor;
+flat out vec3 SpecularColor;
+flat out float Shine;
+flat out vec3 CoolOklab;
+flat out vec3 WarmOklab;
+flat out float GoochAlpha;
+flat out float GoochBeta;
+
 uniform mat4 MVP;
 uniform mat4 MV;
+uniform samplerBuffer Transforms; // world matrices, four texels each
+uniform samplerBuffer Materials; // four texels each, see Scene::load
 uniform mat4 LightSpaceMatrix;
 uniform vec3 LightPosition;
 
+mat4 model_matrix() {
+    int first = VertexDraw.x * 4;
+    return mat4(
+        texelFetch(Transforms, first),
+        texelFetch(Transforms, first + 1),
+        texelFetch(Transforms, first + 2),
+        texelFetch(Transforms, first + 3)
+    );
+}
+
+void fetch_material() {
+    int first = VertexDraw.y * 4;
+    vec4 diffuse_shine = texelFetch(Materials, first);
+    vec4 specular_alpha = texelFetch(Materials, first + 1);
+    vec4 cool_beta = texelFetch(Materials, first + 2);
+    BaseColor = diffuse_shine.rgb;
+    Shine = diffuse_shine.a;
+    SpecularColor = specular_alpha.rgb;
+    GoochAlpha = specular_alpha.a;
+    CoolOklab = cool_beta.rgb;
+    GoochBeta = cool_beta.a;
+    WarmOklab = texelFetch(Materials, first + 3).rgb;
+}
+
 void main() {
-    FragPosition = VertexPosition;
-    LightViewPosition = LightSpaceMatrix * vec4(VertexPosition, 1);
+    fetch_material();
+    mat4 Model = model_matrix();
+    vec4 world_position = Model * vec4(VertexPosition, 1.0);
+    FragPosition = world_position.xyz;
+    LightViewPosition = LightSpaceMatrix * world_position;
     // TODO: calculate in cpp and pass as uniform
     NormalMatrix = transpose(inverse(mat3(MV)));
-    Normal = normalize(NormalMatrix * VertexNormal);
+    // scene transforms only scale uniformly, so mat3(Model) keeps normals
+    // perpendicular
+    Normal = normalize(NormalMatrix * mat3(Model) * VertexNormal);
     TexCoord = VertexTexCoord;
 
-    gl_Position = MVP * vec4(VertexPosition, 1.0);
+    gl_Position = MVP * world_position;
 }
@@ -1,17 +1,27 @@
 #version 410 core
 in vec2 TexCoord;
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out uint PaletteIndex; // only stored by indexed captures
 
 uniform sampler2D ScreenTexture;
-uniform sampler2D DepthTexture;
+uniform sampler2D LinearDepthTexture;
 uniform int TogglePalette;
 uniform float Dither;
+uniform vec2 UVScale; // fraction of ScreenTexture that holds the image
+uniform float PixelScale; // output pixels per rendered texel; >1 when fused with the upscale
+uniform int EncodeSRGB; // 1 when writing linear RGB to a canvas that won't encode it (--srgb)
+
+// batch palettes in Oklab, one per layer; PaletteLayer -1 uses PALETTE below
+uniform sampler1DArray PaletteTexture;
+uniform int PaletteLayer;
+uniform int PaletteSize;
+uniform vec2 TileOffset; // where this pass's tile starts in the batch atlas
 
 // EDGE CONSTANTS
 const float EDGE_THRESHOLD = 0.003;
 const float EDGE_THRESHOLD_FEATHER = 0.00225;
 const vec3 EDGE_COLOR = vec3(0, 0, 0);
-const float STROKE_RADIUS = 0.55;
+const float STROKE_RADIUS = 0.55; // in texels; scales the 2-texel central difference
 
 // PALETTE MATCHING CONSTANTS
 const int BAYER_N = 4;
@@ -38,41 +48,53 @@ const vec3[] PALETTE = vec3[](
 );
 
 
+// rendered texel this fragment resolves
+ivec2 texel;
+ivec2 max_texel;
+
 // FORWARD DECLARATIONS - OUTLINES
 void apply_edges();
-float linearize_depth(float depth);
+float depth_at(ivec2 offset);
 
 // FORWARD DECLARATIONS - UTILITY FUNCTIONS
 vec3 oklab_from_rgb(vec3 rgb);
+vec3 cbrt_fast(vec3 x);
 vec3 rgb_from_oklab(vec3 oklab);
+vec3 srgb_from_linear(vec3 rgb);
 
 // FORWARD DECLARATIONS - PALETTE MATCHING
 void lock_to_palette();
-vec3 closest_candiate(vec3 target);
+int closest_candiate(vec3 target);
+vec3 palette_color(int index);
 
 void main() {
-    FragColor = texture(ScreenTexture, TexCoord);
+    vec2 render_size = vec2(textureSize(ScreenTexture, 0)) * UVScale;
+    texel = ivec2((gl_FragCoord.xy - TileOffset) / PixelScale);
+    max_texel = ivec2(render_size) - 1;
+
+    FragColor = texelFetch(ScreenTexture, texel, 0);
+    PaletteIndex = 0u;
     apply_edges();
     if (TogglePalette == 1) {
         lock_to_palette();
     }
+    if (EncodeSRGB == 1) {
+        FragColor.rgb = srgb_from_linear(FragColor.rgb);
+    }
 }
 
 // OUTLINES
 
 void apply_edges() {
-    float pixel_size_x = STROKE_RADIUS / textureSize(ScreenTexture, 0).x;
-    float pixel_size_y = STROKE_RADIUS / textureSize(ScreenTexture, 0).y;
-
-    float left_depth = linearize_depth(texture(DepthTexture, TexCoord + vec2(-pixel_size_x, 0.0)).r);
-    float right_depth = linearize_depth(texture(DepthTexture, TexCoord + vec2(pixel_size_x, 0.0)).r);
-    float top_depth = linearize_depth(texture(DepthTexture, TexCoord + vec2(0.0, pixel_size_y)).r);
-    float bottom_depth = linearize_depth(texture(DepthTexture, TexCoord + vec2(0.0, -pixel_size_y)).r);
+    float left_depth = depth_at(ivec2(-1, 0));
+    float right_depth = depth_at(ivec2(1, 0));
+    float top_depth = depth_at(ivec2(0, 1));
+    float bottom_depth = depth_at(ivec2(0, -1));
 
     float horizontal_diff = abs(right_depth - left_depth);
     float vertical_diff = abs(top_depth - bottom_depth);
 
-    float edge_intensity = max(horizontal_diff, vertical_diff);
+    float edge_intensity = max(horizontal_diff, vertical_diff) * STROKE_RADIUS;
 
     // Apply edge detection
     if (edge_intensity > EDGE_THRESHOLD) {
@@ -85,27 +107,28 @@ void apply_edges() {
     }
 }
 
-float linearize_depth(float depth) {
-    float near = 1.0;
-    float far = 5000.0;
-    float linear_depth = (2.0 * near) / (far + near - depth * (far - near));
-    return linear_depth;
+float depth_at(ivec2 offset) {
+    ivec2 coord = clamp(texel + offset, ivec2(0), max_texel);
+    return texelFetch(LinearDepthTexture, coord, 0).r;
 }
 
 // PALETTE MATCHING
 
 void lock_to_palette() {
-    ivec2 pixel_coordinate = ivec2(gl_FragCoord.xy);
+    ivec2 pixel_coordinate = texel;
     vec3 original_color = FragColor.rgb;
     vec3 original_oklab = oklab_from_rgb(FragColor.rgb);
 
     vec3 error = vec3(0, 0, 0);
     vec3[BAYER_N_SQ] candidates;
+    int[BAYER_N_SQ] candidate_indices;
 
     for (int j = 0; j < BAYER_N_SQ; j++) {
         vec3 sample_c = original_oklab + error * Dither;
-        vec3 candidate = closest_candiate(sample_c);
+        int candidate_index = closest_candiate(sample_c);
+        vec3 candidate = palette_color(candidate_index);
         candidates[j] = candidate;
+        candidate_indices[j] = candidate_index;
         error += (original_color - candidate);
     }
 
@@ -116,6 +139,9 @@ void lock_to_palette() {
                 vec3 temp = candidates[j];
                 candidates[j] = candidates[j + 1];
                 candidates[j + 1] = temp;
+                int temp_index = candidate_indices[j];
+                candidate_indices[j] = candidate_indices[j + 1];
+                candidate_indices[j + 1] = temp_index;
             }
         }
     }
@@ -127,24 +153,46 @@ void lock_to_palette() {
     vec3 closest_match_rgb = rgb_from_oklab(candidates[BAYER_MATRIX[index]]);
 
     FragColor = vec4(closest_match_rgb, 1);
+    PaletteIndex = uint(candidate_indices[BAYER_MATRIX[index]]);
 }
 
-vec3 closest_candiate(vec3 target) {
-    vec3 closest;
+// index of the palette color nearest to target
+int closest_candiate(vec3 target) {
+    int closest = 0;
     float dist_of_closest = 100000000.0;
 
+    if (PaletteLayer >= 0) {
+        for (int i = 0; i < PaletteSize; i++) {
+            vec3 color = texelFetch(PaletteTexture, ivec2(i, PaletteLayer), 0).rgb;
+            vec3 delta = color - target;
+            float d = dot(delta, delta); // magnitude squared
+            if (d < dist_of_closest) {
+                dist_of_closest = d;
+                closest = i;
+            }
+        }
+        return closest;
+    }
+
     for (int i = 0; i < PALETTE.length(); i++) {
         vec3 color = PALETTE[i];
         vec3 delta = color - target;
         float d = dot(delta, delta); // magnitude squared
         if (d < dist_of_closest) {
             dist_of_closest = d;
-            closest = color;
+            closest = i;
         }
     }
     return closest;
 }
 
+vec3 palette_color(int index) {
+    if (PaletteLayer >= 0) {
+        return texelFetch(PaletteTexture, ivec2(index, PaletteLayer), 0).rgb;
+    }
+    return PALETTE[index];
+}
+
 // UTILITY FUNCTIONS
 vec3 oklab_from_rgb(vec3 rgb) {
     // https://bottosson.github.io/posts/oklab
@@ -158,7 +206,7 @@ vec3 oklab_from_rgb(vec3 rgb) {
 
     vec3 lms = im1 * rgb;
 
-    return im2 * (sign(lms) * pow(abs(lms), vec3(1.0 / 3.0)));
+    return im2 * cbrt_fast(lms);
 }
 
 vec3 rgb_from_oklab(vec3 oklab) {
@@ -174,3 +222,19 @@ vec3 rgb_from_oklab(vec3 oklab) {
 
     return m2 * (lms * lms * lms);
 }
+
+// Cube root from an exponent-dividing bit trick plus one Halley step; within
+// 6e-5 Oklab distance of pow(x, 1/3) over the sRGB cube. The clamp keeps
+// y^3 out of denormals (flushed to zero on GPUs) for black inputs.
+vec3 cbrt_fast(vec3 x) {
+    vec3 a = max(abs(x), vec3(1e-18));
+    vec3 y = uintBitsToFloat(floatBitsToUint(a) / 3u + 0x2a5137a0u);
+    vec3 y3 = y * y * y;
+    y *= (y3 + 2.0 * a) / (2.0 * y3 + a);
+    return sign(x) * y;
+}
+
+vec3 srgb_from_linear(vec3 rgb) {
+    vec3 c = clamp(rgb, 0.0, 1.0);
+    return mix(c * 12.92, 1.055 * pow(c, vec3(1.0 / 2.4)) - 0.055, step(0.0031308, c));
+}
@@ -1,8 +1,20 @@
 #version 410 core
 layout(location = 0) in vec3 VertexPosition;
+layout(location = 3) in ivec2 VertexDraw; // transform node, material
 
 uniform mat4 MVP;
+uniform samplerBuffer Transforms; // world matrices, four texels each
+
+mat4 model_matrix() {
+    int first = VertexDraw.x * 4;
+    return mat4(
+        texelFetch(Transforms, first),
+        texelFetch(Transforms, first + 1),
+        texelFetch(Transforms, first + 2),
+        texelFetch(Transforms, first + 3)
+    );
+}
 
 void main() {
-    gl_Position = MVP * vec4(VertexPosition, 1.0);
+    gl_Position = MVP * model_matrix() * vec4(VertexPosition, 1.0);
 }
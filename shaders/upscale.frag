@@ -3,8 +3,21 @@ in vec2 TexCoord;
 out vec4 FragColor;
 
 uniform sampler2D ScreenTexture;
+uniform vec2 UVScale; // fraction of ScreenTexture that holds the image
+uniform int EncodeSRGB; // 1 when ScreenTexture decodes to linear but the canvas won't encode
+
+vec3 srgb_from_linear(vec3 rgb);
 
 void main() {
-    vec4 base_color = texture(ScreenTexture, TexCoord);
+    vec4 base_color = texture(ScreenTexture, TexCoord * UVScale);
+    if (EncodeSRGB == 1) {
+        base_color.rgb = srgb_from_linear(base_color.rgb);
+    }
     FragColor = vec4(base_color.rgb, 1);
 }
+
+vec3 srgb_from_linear(vec3 rgb) {
+    vec3 c = clamp(rgb, 0.0, 1.0);
+    return mix(c * 12.92, 1.055 * pow(c, vec3(1.0 / 2.4)) - 0.055, step(0.0031308, c));
+}
+
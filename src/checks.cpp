@@ -0,0 +1,568 @@
+// Standalone checks for the CPU-side color and mesh code, run with
+// `make check` from the repository root.
+// Each one prints what it measured and returns false if a bound the code
+// documents doesn't hold. Timings are informational only.
+
+#include "internal/imagewrite.h"
+#include "internal/meshlod.h"
+#include "internal/paletteparser.h"
+#include "internal/palettescore.h"
+#include "lodepng.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// the scoring and PNG benchmarks' reference image, and the palette the PNG
+// benchmark reduces it to
+const char* REFERENCE_IMAGE = "screenshots/palette_matching_off.png";
+const char* REFERENCE_PALETTE = "palette.txt";
+const int RANDOM_PALETTES = 2000;
+
+// timed loops store their results here so they can't be optimized away
+static volatile float benchmark_sink;
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+static float oklab_distance(Color3f a, Color3f b) {
+    float dx = a.x - b.x;
+    float dy = a.y - b.y;
+    float dz = a.z - b.z;
+    return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+// oklab_from_rgb_fast against oklab_from_rgb over every 8-bit sRGB color,
+// then both conversions' throughput over the same colors.
+static bool check_fast_cbrt() {
+    const float MAX_ERROR = 6e-5f;
+
+    std::vector<Color3f> colors;
+    colors.reserve(256 * 256 * 256);
+    for (int r = 0; r < 256; r++) {
+        for (int g = 0; g < 256; g++) {
+            for (int b = 0; b < 256; b++) {
+                colors.push_back({r / 255.0f, g / 255.0f, b / 255.0f});
+            }
+        }
+    }
+
+    float max_error = 0.0f;
+    for (Color3f rgb : colors) {
+        float error =
+            oklab_distance(oklab_from_rgb(rgb), oklab_from_rgb_fast(rgb));
+        max_error = std::max(max_error, error);
+    }
+
+    float sum = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for (Color3f rgb : colors) {
+        sum += oklab_from_rgb(rgb).x;
+    }
+    double exact_seconds = seconds_since(start);
+    benchmark_sink = sum;
+
+    start = std::chrono::steady_clock::now();
+    for (Color3f rgb : colors) {
+        sum += oklab_from_rgb_fast(rgb).x;
+    }
+    double fast_seconds = seconds_since(start);
+    benchmark_sink = sum;
+
+    double mcolors = colors.size() / 1e6;
+    std::cout << "fast_cbrtf: max Oklab error " << max_error << " over "
+              << colors.size() << " sRGB colors (bound " << MAX_ERROR
+              << "); " << mcolors / fast_seconds << " vs "
+              << mcolors / exact_seconds << " Mcolors/s with cbrtf"
+              << std::endl;
+    return max_error < MAX_ERROR;
+}
+
+// the transfer functions the sRGB tables are built from
+static float exact_linear_from_srgb(float c) {
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float exact_srgb_from_linear(float c) {
+    return c <= 0.0031308f ? c * 12.92f
+                           : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+// linear_from_srgb8 and srgb8_from_linear against the exact transfer
+// functions: every code decodes exactly and survives a round trip, and
+// random linear values encode within one code of the exact rounding.
+static bool check_srgb_tables() {
+    const int RANDOM_INPUTS = 10000000;
+    bool ok = true;
+
+    int round_trip_failures = 0;
+    for (int i = 0; i < 256; i++) {
+        float linear = linear_from_srgb8((uint8_t)i);
+        if (linear != exact_linear_from_srgb(i / 255.0f)) {
+            std::cout << "linear_from_srgb8(" << i << ") is " << linear
+                      << ", expected " << exact_linear_from_srgb(i / 255.0f)
+                      << std::endl;
+            ok = false;
+        }
+        if (srgb8_from_linear(linear) != i) {
+            round_trip_failures++;
+        }
+    }
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<float> inputs(RANDOM_INPUTS);
+    for (float& input : inputs) {
+        input = unit(rng);
+    }
+
+    int max_code_error = 0;
+    for (float input : inputs) {
+        int exact = (int)lroundf(exact_srgb_from_linear(input) * 255.0f);
+        int error = std::abs(srgb8_from_linear(input) - exact);
+        max_code_error = std::max(max_code_error, error);
+    }
+
+    unsigned int sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (float input : inputs) {
+        sum += (unsigned int)lroundf(exact_srgb_from_linear(input) * 255.0f);
+    }
+    double exact_seconds = seconds_since(start);
+    benchmark_sink = (float)sum;
+
+    start = std::chrono::steady_clock::now();
+    for (float input : inputs) {
+        sum += srgb8_from_linear(input);
+    }
+    double table_seconds = seconds_since(start);
+    benchmark_sink = (float)sum;
+
+    std::cout << "sRGB tables: " << round_trip_failures
+              << " of 256 codes fail a round trip; encoding "
+              << RANDOM_INPUTS << " random values is at most "
+              << max_code_error << " code off, in "
+              << table_seconds * 1000.0 << " ms vs "
+              << exact_seconds * 1000.0 << " ms with powf" << std::endl;
+    return ok && round_trip_failures == 0 && max_code_error <= 1;
+}
+
+// Writes count seeded random .hex palettes of 4 to 64 colors into dir and
+// returns their paths in order.
+static std::vector<std::string>
+write_random_palettes(const std::filesystem::path& dir, int count) {
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> size(4, 64);
+    std::uniform_int_distribution<int> channel(0, 255);
+
+    std::filesystem::create_directories(dir);
+    std::vector<std::string> paths;
+    for (int i = 0; i < count; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "random_%04d.hex", i);
+        std::string path = (dir / name).string();
+        std::ofstream file(path);
+        for (int c = size(rng); c > 0; c--) {
+            char line[8];
+            snprintf(
+                line,
+                sizeof(line),
+                "%02x%02x%02x",
+                channel(rng),
+                channel(rng),
+                channel(rng)
+            );
+            file << line << "\n";
+        }
+        paths.push_back(path);
+    }
+    return paths;
+}
+
+// Writes text to dir/name and returns the path.
+static std::string write_file(
+    const std::filesystem::path& dir,
+    const char* name,
+    const std::string& text
+) {
+    std::string path = (dir / name).string();
+    std::ofstream(path, std::ios::binary) << text;
+    return path;
+}
+
+// Each palette format the parser reads, checked byte for byte, and the
+// exact messages for malformed files.
+static bool check_palette_formats(const std::filesystem::path& dir) {
+    using Colors = std::vector<std::array<uint8_t, 3>>;
+    struct Case {
+        std::string path;
+        Colors expected;
+    };
+
+    // a 5x1 swatch strip: two colors, a transparent gap and a repeat
+    std::vector<unsigned char> strip = {
+        255, 0,  0,   255, // red
+        0,   0,  0,   0,   // gap
+        10,  20, 30,  255, //
+        255, 0,  0,   255, // red again
+        0,   0,  255, 0    // transparent, ignored
+    };
+    std::string png_path = (dir / "strip.png").string();
+    lodepng::encode(png_path, strip, 5, 1);
+
+    std::vector<Case> cases = {
+        {write_file(dir, "plain.hex", "ff0000\n#00ff00\n\n0000FF\n"),
+         {{255, 0, 0}, {0, 255, 0}, {0, 0, 255}}},
+        {write_file(
+             dir,
+             "paintnet.txt",
+             ";paint.net Palette File\n; two colors\nFF102030\n80A0B0C0\n"
+         ),
+         {{16, 32, 48}, {160, 176, 192}}},
+        {write_file(
+             dir,
+             "gimp.gpl",
+             "GIMP Palette\nName: test\nColumns: 2\n#\n"
+             "255 128   0\tOrange\n  1   2   3 Untitled\n"
+         ),
+         {{255, 128, 0}, {1, 2, 3}}},
+        {write_file(
+             dir,
+             "jasc.pal",
+             "JASC-PAL\r\n0100\r\n2\r\n9 8 7\r\n255 255 255\r\n"
+         ),
+         {{9, 8, 7}, {255, 255, 255}}},
+        {png_path, {{255, 0, 0}, {10, 20, 30}}},
+    };
+
+    bool ok = true;
+    PaletteParser parser;
+    Palette palette;
+    std::string error;
+    for (const Case& c : cases) {
+        if (!parser.load(c.path, false, palette, error)) {
+            std::cout << "Palette format check: " << error << std::endl;
+            ok = false;
+        } else if (palette.srgb != c.expected) {
+            std::cout << "Palette format check: " << c.path << " parsed to "
+                      << palette.size() << " wrong colors" << std::endl;
+            ok = false;
+        }
+    }
+
+    std::string bad_hex =
+        write_file(dir, "bad.hex", "; comment\nff0000\nff00zz\n");
+    std::string bad_jasc =
+        write_file(dir, "bad.pal", "JASC-PAL\n0100\n3\n1 2 3\n4 5 6\n");
+    std::vector<std::pair<std::string, std::string>> failures = {
+        {bad_hex,
+         bad_hex
+             + ": line 3: expected RRGGBB, #RRGGBB or AARRGGBB, got 'ff00zz'"},
+        {bad_jasc, bad_jasc + ": line 3: header lists 3 colors, found 2"},
+    };
+    for (const auto& [path, expected] : failures) {
+        bool loaded = parser.load(path, false, palette, error);
+        if (loaded || error != expected || palette.size() != 0) {
+            std::cout << "Palette format check: " << path << " gave '"
+                      << (loaded ? "no error" : error) << "', expected '"
+                      << expected << "'" << std::endl;
+            ok = false;
+        }
+    }
+
+    std::cout << "Palette formats: " << cases.size() << " formats and "
+              << failures.size() << " malformed files "
+              << (ok ? "parsed as expected" : "FAILED") << std::endl;
+    return ok;
+}
+
+// Loads every random palette with one reused parser, a few passes over the
+// files so the timing isn't just the first pass's cold cache.
+static bool check_palette_loading(const std::vector<std::string>& paths) {
+    const int PASSES = 5;
+
+    PaletteParser parser;
+    Palette palette;
+    std::string error;
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < PASSES; pass++) {
+        for (const std::string& path : paths) {
+            if (!parser.load(path, false, palette, error)) {
+                std::cout << error << std::endl;
+                return false;
+            }
+        }
+    }
+    double seconds = seconds_since(start);
+
+    std::cout << "Loaded " << paths.size() << " palettes in "
+              << seconds * 1000.0 / PASSES << " ms per pass" << std::endl;
+    return true;
+}
+
+// Ranks the random palettes against the reference image; every palette
+// must come back scored and named.
+static bool check_palette_scoring(
+    const std::vector<unsigned char>& rgba,
+    int width,
+    int height,
+    const std::vector<std::string>& palette_paths
+) {
+    auto start = std::chrono::steady_clock::now();
+    ScoringReference reference(rgba.data(), width, height, false);
+    double reference_seconds = seconds_since(start);
+    std::cout << "Scoring reference built in " << reference_seconds * 1000.0
+              << " ms" << std::endl;
+
+    // prints its own timing
+    std::vector<PaletteScore> scores =
+        score_palettes(reference, palette_paths, false);
+
+    bool ok = scores.size() == palette_paths.size();
+    for (const PaletteScore& score : scores) {
+        ok = ok && !score.path.empty() && std::isfinite(score.cost);
+    }
+    if (!ok) {
+        std::cout << "Palette scoring lost or misnamed palettes" << std::endl;
+    }
+    return ok;
+}
+
+// Reduces the reference to the palette by nearest Oklab color, then saves
+// it both as RGBA and as indices. The indexed file must decode to the same
+// pixels; sizes and encode times are printed.
+static bool check_indexed_png(
+    const std::vector<unsigned char>& rgba,
+    int width,
+    int height,
+    const std::filesystem::path& dir
+) {
+    PaletteParser parser;
+    Palette palette;
+    std::string error;
+    if (!parser.load(REFERENCE_PALETTE, false, palette, error)) {
+        std::cout << error << std::endl;
+        return false;
+    }
+
+    std::vector<uint8_t> indices(width * height);
+    std::vector<unsigned char> reduced(width * height * 4);
+    for (int i = 0; i < width * height; i++) {
+        const unsigned char* p = &rgba[i * 4];
+        Color3f c = oklab_from_rgb_fast(
+            Color3f {p[0] / 255.0f, p[1] / 255.0f, p[2] / 255.0f}
+        );
+        float best = INFINITY;
+        for (size_t k = 0; k < palette.size(); k++) {
+            float d = oklab_distance(c, palette.oklab[k]);
+            if (d < best) {
+                best = d;
+                indices[i] = k;
+            }
+        }
+        const std::array<uint8_t, 3>& srgb = palette.srgb[indices[i]];
+        reduced[i * 4 + 0] = srgb[0];
+        reduced[i * 4 + 1] = srgb[1];
+        reduced[i * 4 + 2] = srgb[2];
+        reduced[i * 4 + 3] = 255;
+    }
+
+    std::string rgba_path = (dir / "rgba.png").string();
+    std::string indexed_path = (dir / "indexed.png").string();
+
+    auto start = std::chrono::steady_clock::now();
+    if (!write_rgba_png(rgba_path, reduced.data(), width, height)) {
+        return false;
+    }
+    double rgba_seconds = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    if (!write_indexed_png(
+            indexed_path,
+            indices.data(),
+            width,
+            height,
+            palette
+        )) {
+        return false;
+    }
+    double indexed_seconds = seconds_since(start);
+
+    std::vector<unsigned char> decoded;
+    unsigned int decoded_width, decoded_height;
+    unsigned int decode_error = lodepng::decode(
+        decoded,
+        decoded_width,
+        decoded_height,
+        indexed_path
+    );
+    bool same = !decode_error && decoded == reduced;
+    if (!same) {
+        std::cout << "Indexed PNG doesn't decode to the RGBA pixels"
+                  << std::endl;
+    }
+
+    std::cout << "Indexed PNG (" << palette.size() << " colors): "
+              << std::filesystem::file_size(indexed_path) << " bytes in "
+              << indexed_seconds * 1000.0 << " ms vs "
+              << std::filesystem::file_size(rgba_path) << " bytes in "
+              << rgba_seconds * 1000.0 << " ms as RGBA" << std::endl;
+    return same;
+}
+
+// A closed torus with no seams: rings around the tube times segments around
+// the hole, two triangles per quad, position, normal and texture coordinate
+// per vertex (the layout read_mesh_asset produces).
+static void build_torus(
+    int rings,
+    int segments,
+    std::vector<float>& vertices,
+    std::vector<unsigned int>& indices
+) {
+    const float MAJOR = 10.0f;
+    const float MINOR = 3.0f;
+    for (int s = 0; s < segments; s++) {
+        float u = 2.0f * (float)M_PI * s / segments;
+        for (int r = 0; r < rings; r++) {
+            float v = 2.0f * (float)M_PI * r / rings;
+            float nx = cosf(v) * cosf(u);
+            float ny = cosf(v) * sinf(u);
+            float nz = sinf(v);
+            float along = MAJOR + MINOR * cosf(v);
+            float vertex[8] = {
+                along * cosf(u),
+                along * sinf(u),
+                MINOR * nz,
+                nx,
+                ny,
+                nz,
+                (float)s / segments,
+                (float)r / rings
+            };
+            vertices.insert(vertices.end(), vertex, vertex + 8);
+        }
+    }
+    for (int s = 0; s < segments; s++) {
+        for (int r = 0; r < rings; r++) {
+            unsigned int a = s * rings + r;
+            unsigned int b = s * rings + (r + 1) % rings;
+            unsigned int c = (s + 1) % segments * rings + r;
+            unsigned int d = (s + 1) % segments * rings + (r + 1) % rings;
+            unsigned int quad[6] = {a, c, d, a, d, b};
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+// build_lods on a closed torus: each level keeps about a quarter of the
+// previous one's triangles with valid indices and a growing error, and a
+// load_lods cache write and read both return the same levels.
+static bool check_mesh_lods() {
+    const int STRIDE = 8;
+    const char* CACHE_NAME = "check_torus";
+
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    build_torus(64, 128, vertices, indices);
+    size_t vertex_count = vertices.size() / STRIDE;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<LODIndices> lods = build_lods(vertices, STRIDE, indices);
+    double build_seconds = seconds_since(start);
+
+    bool ok = lods.size() == MAX_LODS && lods[0].indices == indices
+        && lods[0].error == 0.0f;
+    std::cout << "Mesh LODs:";
+    for (size_t level = 0; level < lods.size(); level++) {
+        const std::vector<unsigned int>& level_indices = lods[level].indices;
+        std::cout << (level ? " / " : " ") << level_indices.size() / 3;
+        for (unsigned int index : level_indices) {
+            ok = ok && index < vertex_count;
+        }
+        if (level > 0) {
+            double ratio = (double)lods[level - 1].indices.size()
+                / level_indices.size();
+            ok = ok && ratio > 3.0 && ratio < 5.0;
+            ok = ok && lods[level].error > lods[level - 1].error;
+        }
+    }
+    std::cout << " triangles in " << build_seconds * 1000.0 << " ms";
+
+    // start from an empty cache entry so the first call writes it
+    std::error_code error;
+    if (std::filesystem::is_directory("mesh_cache")) {
+        for (const auto& entry :
+             std::filesystem::directory_iterator("mesh_cache")) {
+            if (entry.path().filename().string().starts_with(CACHE_NAME)) {
+                std::filesystem::remove(entry.path(), error);
+            }
+        }
+    }
+    std::string obj_path = std::string(CACHE_NAME) + ".obj";
+    std::vector<LODIndices> written =
+        load_lods(obj_path, vertices, STRIDE, indices);
+    bool cached = false;
+    for (const auto& entry :
+         std::filesystem::directory_iterator("mesh_cache", error)) {
+        if (entry.path().filename().string().starts_with(CACHE_NAME)) {
+            cached = true;
+            std::vector<LODIndices> read =
+                load_lods(obj_path, vertices, STRIDE, indices);
+            bool same = read.size() == lods.size()
+                && written.size() == lods.size();
+            for (size_t level = 0; same && level < lods.size(); level++) {
+                same = read[level].indices == lods[level].indices
+                    && written[level].indices == lods[level].indices
+                    && read[level].error == lods[level].error;
+            }
+            ok = ok && same;
+            std::filesystem::remove(entry.path(), error);
+        }
+    }
+    ok = ok && cached;
+    std::cout << (cached ? ", cache round trip checked" : ", cache not written")
+              << std::endl;
+    return ok;
+}
+
+int main() {
+    bool ok = true;
+    ok = check_fast_cbrt() && ok;
+    ok = check_srgb_tables() && ok;
+    ok = check_mesh_lods() && ok;
+
+    std::vector<unsigned char> rgba;
+    unsigned int width, height;
+    unsigned int error = lodepng::decode(rgba, width, height, REFERENCE_IMAGE);
+    if (error) {
+        std::cout << "Failed to load " << REFERENCE_IMAGE << ": "
+                  << lodepng_error_text(error) << std::endl;
+        return 1;
+    }
+
+    std::filesystem::path dir =
+        std::filesystem::temp_directory_path() / "palette_matcher_checks";
+    std::vector<std::string> palette_paths =
+        write_random_palettes(dir, RANDOM_PALETTES);
+    ok = check_palette_formats(dir) && ok;
+    ok = check_palette_loading(palette_paths) && ok;
+    ok = check_palette_scoring(rgba, width, height, palette_paths) && ok;
+    ok = check_indexed_png(rgba, width, height, dir) && ok;
+    std::filesystem::remove_all(dir);
+
+    std::cout << (ok ? "All checks passed" : "Some checks FAILED")
+              << std::endl;
+    return ok ? 0 : 1;
+}
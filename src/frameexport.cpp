@@ -0,0 +1,131 @@
+#include "internal/frameexport.h"
+#include "internal/imagewrite.h"
+#include "internal/parallel.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+static Color3f oklab_from_srgb8(const uint8_t* c) {
+    return oklab_from_rgb_fast({c[0] / 255.0f, c[1] / 255.0f, c[2] / 255.0f});
+}
+
+// The effect already quantized most pixels, so a frame has few distinct
+// colors and the nearest-color search runs once per color, not per pixel.
+static std::vector<uint8_t>
+palettize(const CapturedFrame& frame, const std::vector<Color3f>& palette) {
+    std::vector<uint8_t> indices((size_t)frame.width * frame.height);
+    std::unordered_map<uint32_t, uint8_t> nearest_of;
+    for (size_t i = 0; i < indices.size(); i++) {
+        const unsigned char* p = frame.rgba.data() + i * 4;
+        uint32_t key = p[0] | (p[1] << 8) | (p[2] << 16);
+        auto [it, inserted] = nearest_of.try_emplace(key, 0);
+        if (inserted) {
+            Color3f c = oklab_from_srgb8(p);
+            float best = INFINITY;
+            for (size_t k = 0; k < palette.size(); k++) {
+                float dx = palette[k].x - c.x;
+                float dy = palette[k].y - c.y;
+                float dz = palette[k].z - c.z;
+                float d = dx * dx + dy * dy + dz * dz;
+                if (d < best) {
+                    best = d;
+                    it->second = k;
+                }
+            }
+        }
+        indices[i] = it->second;
+    }
+    return indices;
+}
+
+static bool write_sprite_sheet(
+    const std::string& path,
+    const std::vector<std::vector<uint8_t>>& frames,
+    int width,
+    int height,
+    const Palette& palette
+) {
+    int count = frames.size();
+    int columns = (int)ceil(sqrt((double)count));
+    int rows = (count + columns - 1) / columns;
+    int sheet_width = columns * width;
+
+    std::vector<uint8_t> sheet((size_t)sheet_width * rows * height, 0);
+    parallel_for(count, [&](size_t f) {
+        int x0 = (f % columns) * width;
+        int y0 = (f / columns) * height;
+        for (int y = 0; y < height; y++) {
+            memcpy(
+                sheet.data() + (size_t)(y0 + y) * sheet_width + x0,
+                frames[f].data() + (size_t)y * width,
+                width
+            );
+        }
+    });
+
+    std::cout << "Sprite sheet: " << columns << "x" << rows << " frames of "
+              << width << "x" << height << std::endl;
+    return write_indexed_png(
+        path,
+        sheet.data(),
+        sheet_width,
+        rows * height,
+        palette
+    );
+}
+
+bool export_frames(
+    const std::string& path,
+    const std::vector<CapturedFrame>& frames,
+    const Palette& palette,
+    int delay
+) {
+    if (frames.empty()) {
+        std::cout << "Failed to save " << path << ": no frames" << std::endl;
+        return false;
+    }
+    if (palette.size() > 256) {
+        std::cout << "Failed to save " << path << ": " << palette.size()
+                  << " colors don't fit 8-bit indices" << std::endl;
+        return false;
+    }
+    int width = frames[0].width;
+    int height = frames[0].height;
+    for (const CapturedFrame& frame : frames) {
+        if (frame.width != width || frame.height != height) {
+            std::cout << "Failed to save " << path
+                      << ": the window was resized while exporting"
+                      << std::endl;
+            return false;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<Color3f> oklab;
+    for (const std::array<uint8_t, 3>& c : palette.srgb) {
+        oklab.push_back(oklab_from_srgb8(c.data()));
+    }
+    std::vector<std::vector<uint8_t>> indices(frames.size());
+    parallel_for(frames.size(), [&](size_t i) {
+        indices[i] = palettize(frames[i], oklab);
+    });
+    auto palettized = std::chrono::steady_clock::now();
+
+    bool gif = path.ends_with(".gif") || path.ends_with(".GIF");
+    bool saved = gif
+        ? write_indexed_gif(path, indices, width, height, palette, delay)
+        : write_sprite_sheet(path, indices, width, height, palette);
+    auto written = std::chrono::steady_clock::now();
+
+    using ms = std::chrono::duration<double, std::milli>;
+    std::cout << "Encoded " << frames.size() << " frames on "
+              << std::max(1u, std::thread::hardware_concurrency())
+              << " threads: palettized in " << ms(palettized - start).count()
+              << " ms, " << (gif ? "GIF" : "PNG") << " written in "
+              << ms(written - palettized).count() << " ms" << std::endl;
+    return saved;
+}
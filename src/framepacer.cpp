@@ -0,0 +1,102 @@
+#include "internal/framepacer.h"
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+FramePacer::FramePacer() :
+    frame_interval(0),
+    next_frame_time(0),
+    input_time(0),
+    last_present_time(0),
+    latency_total(0),
+    frame_time_total(0),
+    samples(0) {}
+
+FramePacer::~FramePacer() {
+    for (PendingFrame& frame : pending) {
+        glDeleteSync(frame.fence);
+    }
+}
+
+void FramePacer::setSwapInterval(int interval) {
+    glfwSwapInterval(interval);
+    std::cout << "Swap interval: " << interval << std::endl;
+}
+
+void FramePacer::setFrameLimit(double fps) {
+    frame_interval = fps > 0 ? 1.0 / fps : 0;
+    next_frame_time = glfwGetTime();
+}
+
+void FramePacer::waitForNextFrame() {
+    if (frame_interval == 0) {
+        return;
+    }
+
+    double now = glfwGetTime();
+    double remaining = next_frame_time - now;
+    if (remaining > SPIN_MARGIN) {
+        std::this_thread::sleep_for(
+            std::chrono::duration<double>(remaining - SPIN_MARGIN)
+        );
+    }
+    while (glfwGetTime() < next_frame_time) {
+    }
+
+    // schedule from the deadline so timing errors don't accumulate, but
+    // don't try to catch up after a long stall
+    next_frame_time += frame_interval;
+    now = glfwGetTime();
+    if (next_frame_time < now) {
+        next_frame_time = now + frame_interval;
+    }
+}
+
+void FramePacer::markInput() {
+    input_time = glfwGetTime();
+    // fences are only noticed when polled, so poll often to keep the
+    // estimate tight
+    collectFences();
+}
+
+void FramePacer::markPresent() {
+    if (pending.size() == MAX_PENDING_FRAMES) {
+        glDeleteSync(pending.front().fence);
+        pending.pop_front();
+    }
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pending.push_back({fence, input_time});
+    collectFences();
+}
+
+void FramePacer::collectFences() {
+    while (!pending.empty()) {
+        PendingFrame& frame = pending.front();
+        GLenum status = glClientWaitSync(frame.fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            return;
+        }
+
+        double now = glfwGetTime();
+        if (last_present_time > 0) {
+            latency_total += now - frame.input_time;
+            frame_time_total += now - last_present_time;
+            samples++;
+        }
+        last_present_time = now;
+
+        glDeleteSync(frame.fence);
+        pending.pop_front();
+    }
+
+    if (samples >= REPORT_INTERVAL) {
+        std::cout << "Input-to-present latency (upper bound): "
+                  << latency_total / samples * 1000.0
+                  << " ms (frame time: " << frame_time_total / samples * 1000.0
+                  << " ms)" << std::endl;
+        latency_total = 0;
+        frame_time_total = 0;
+        samples = 0;
+    }
+}
@@ -0,0 +1,214 @@
+#include "internal/framerecorder.h"
+#include "internal/imagewrite.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+FrameRecorder::FrameRecorder() :
+    output_dir("./capture"),
+    lossless(false),
+    next_slot(0),
+    recording(false),
+    frame_index(0),
+    dropped(0),
+    written(0),
+    finishing(false) {
+    for (Readback& slot : ring) {
+        slot = {0, 0, nullptr, 0, 0, 0};
+    }
+}
+
+FrameRecorder::~FrameRecorder() {
+    stop();
+    for (Readback& slot : ring) {
+        if (slot.pbo) {
+            glDeleteBuffers(1, &slot.pbo);
+        }
+    }
+}
+
+void FrameRecorder::start(Sink frame_sink) {
+    if (recording) {
+        return;
+    }
+
+    if (frame_sink) {
+        sink = frame_sink;
+    } else {
+        std::filesystem::create_directories(output_dir);
+        sink = [this](const CapturedFrame& frame) {
+            char name[32];
+            snprintf(name, sizeof(name), "/frame_%05d.png", frame.index);
+            write_rgba_png(
+                output_dir + name,
+                frame.rgba.data(),
+                frame.width,
+                frame.height
+            );
+        };
+    }
+
+    frame_index = 0;
+    dropped = 0;
+    written = 0;
+    finishing = false;
+    recording = true;
+    encoder = std::thread(&FrameRecorder::run, this);
+    std::cout << "Recording started" << std::endl;
+}
+
+void FrameRecorder::stop() {
+    if (!recording) {
+        return;
+    }
+    recording = false;
+    collect(true);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finishing = true;
+    }
+    wake.notify_one();
+    encoder.join();
+
+    std::cout << "Recording stopped: " << written << " frames written, "
+              << dropped << " dropped" << std::endl;
+}
+
+void FrameRecorder::capture(GLuint framebuffer, int width, int height) {
+    if (!recording) {
+        return;
+    }
+    collect(false);
+
+    int index = frame_index++;
+    Readback& slot = ring[next_slot];
+    if (slot.fence && lossless) {
+        collect(true);
+    }
+    if (slot.fence) {
+        // every buffer is still in flight; waiting would stall the frame
+        dropped++;
+        return;
+    }
+    next_slot = (next_slot + 1) % RING_SIZE;
+
+    size_t bytes = (size_t)width * height * 4;
+    if (!slot.pbo) {
+        glGenBuffers(1, &slot.pbo);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    if (slot.capacity < bytes) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+        slot.capacity = bytes;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    // with a pack buffer bound, this only queues the copy
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.index = index;
+    slot.width = width;
+    slot.height = height;
+}
+
+void FrameRecorder::collect(bool wait) {
+    // oldest first, so frames reach the sink in order
+    for (int i = 0; i < RING_SIZE; i++) {
+        Readback& slot = ring[(next_slot + i) % RING_SIZE];
+        if (!slot.fence) {
+            continue;
+        }
+
+        GLbitfield flags = wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0;
+        GLuint64 timeout = wait ? GL_TIMEOUT_IGNORED : 0;
+        GLenum status = glClientWaitSync(slot.fence, flags, timeout);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            return;
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+
+        std::vector<unsigned char> pixels;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (lossless) {
+                drained.wait(lock, [this] {
+                    return (int)queue.size() < MAX_QUEUED_FRAMES;
+                });
+            }
+            if ((int)queue.size() >= MAX_QUEUED_FRAMES) {
+                dropped++;
+                continue;
+            }
+            if (!free_buffers.empty()) {
+                pixels = std::move(free_buffers.back());
+                free_buffers.pop_back();
+            }
+        }
+
+        size_t row_bytes = (size_t)slot.width * 4;
+        pixels.resize(row_bytes * slot.height);
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        const unsigned char* mapped = (const unsigned char*)glMapBufferRange(
+            GL_PIXEL_PACK_BUFFER,
+            0,
+            pixels.size(),
+            GL_MAP_READ_BIT
+        );
+        if (mapped) {
+            // GL rows start at the bottom
+            for (int y = 0; y < slot.height; y++) {
+                memcpy(
+                    pixels.data() + y * row_bytes,
+                    mapped + (slot.height - 1 - y) * row_bytes,
+                    row_bytes
+                );
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (!mapped) {
+            dropped++;
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(
+                {slot.index, slot.width, slot.height, std::move(pixels)}
+            );
+        }
+        wake.notify_one();
+    }
+}
+
+void FrameRecorder::run() {
+    while (true) {
+        CapturedFrame frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return finishing || !queue.empty(); });
+            if (queue.empty()) {
+                return; // finishing, and everything has been written
+            }
+            frame = std::move(queue.front());
+            queue.pop_front();
+        }
+        drained.notify_one();
+
+        sink(frame);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        written++;
+        free_buffers.push_back(std::move(frame.rgba));
+    }
+}
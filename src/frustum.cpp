@@ -0,0 +1,35 @@
+#include "internal/frustum.h"
+
+// https://www.gamedevs.org/uploads/fast-extraction-viewing-frustum-planes-from-world-view-projection-matrix.pdf
+Frustum::Frustum(const cyMatrix4f& view_projection) {
+    cyVec4f row_x = view_projection.GetRow(0);
+    cyVec4f row_y = view_projection.GetRow(1);
+    cyVec4f row_z = view_projection.GetRow(2);
+    cyVec4f row_w = view_projection.GetRow(3);
+
+    planes[0] = row_w + row_x; // left
+    planes[1] = row_w - row_x; // right
+    planes[2] = row_w + row_y; // bottom
+    planes[3] = row_w - row_y; // top
+    planes[4] = row_w + row_z; // near
+    planes[5] = row_w - row_z; // far
+}
+
+bool Frustum::intersectsBox(
+    const cyVec3f& bound_min,
+    const cyVec3f& bound_max
+) const {
+    for (const cyVec4f& plane : planes) {
+        // test the box corner furthest along the plane normal; if even that
+        // one is behind the plane, the whole box is outside the frustum
+        cyVec3f corner(
+            plane.x >= 0 ? bound_max.x : bound_min.x,
+            plane.y >= 0 ? bound_max.y : bound_min.y,
+            plane.z >= 0 ? bound_max.z : bound_min.z
+        );
+        if (plane.XYZ().Dot(corner) + plane.w < 0) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,132 @@
+#include "internal/glstate.h"
+
+#include <iostream>
+
+static int target_slot(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D:
+            return 0;
+        case GL_TEXTURE_BUFFER:
+            return 1;
+        case GL_TEXTURE_1D_ARRAY:
+            return 2;
+        default:
+            return -1;
+    }
+}
+
+GLStateTracker::GLStateTracker() :
+    issued(0),
+    filtered(0),
+    frames(0) {
+    invalidate();
+}
+
+void GLStateTracker::activeTexture(int unit) {
+    if (unit == active_unit) {
+        filtered++;
+        return;
+    }
+    glActiveTexture(GL_TEXTURE0 + unit);
+    active_unit = unit;
+    issued++;
+}
+
+void GLStateTracker::bindTexture(GLenum target, GLuint texture) {
+    int slot = target_slot(target);
+    bool known = active_unit >= 0 && active_unit < MAX_UNITS && slot >= 0;
+    if (known && textures[active_unit][slot] == texture) {
+        filtered++;
+        return;
+    }
+    glBindTexture(target, texture);
+    if (known) {
+        textures[active_unit][slot] = texture;
+    }
+    issued++;
+}
+
+void GLStateTracker::bindTexture(int unit, GLenum target, GLuint texture) {
+    int slot = target_slot(target);
+    if (unit < MAX_UNITS && slot >= 0 && textures[unit][slot] == texture) {
+        // the unit switch is skipped along with the bind
+        filtered += 2;
+        return;
+    }
+    activeTexture(unit);
+    bindTexture(target, texture);
+}
+
+void GLStateTracker::bindVertexArray(GLuint array) {
+    if (array == vertex_array) {
+        filtered++;
+        return;
+    }
+    glBindVertexArray(array);
+    vertex_array = array;
+    issued++;
+}
+
+void GLStateTracker::cullFace(GLenum face) {
+    if (face == cull_face) {
+        filtered++;
+        return;
+    }
+    glCullFace(face);
+    cull_face = face;
+    issued++;
+}
+
+void GLStateTracker::setEnabled(GLenum cap, bool enabled) {
+    Capability* known = nullptr;
+    for (Capability& capability : capabilities) {
+        if (capability.cap == cap) {
+            known = &capability;
+        }
+    }
+    if (known && known->enabled == enabled) {
+        filtered++;
+        return;
+    }
+
+    if (enabled) {
+        glEnable(cap);
+    } else {
+        glDisable(cap);
+    }
+    if (known) {
+        known->enabled = enabled;
+    } else {
+        capabilities.push_back({cap, enabled});
+    }
+    issued++;
+}
+
+void GLStateTracker::invalidate() {
+    active_unit = -1;
+    for (int unit = 0; unit < MAX_UNITS; unit++) {
+        for (int slot = 0; slot < TARGETS; slot++) {
+            textures[unit][slot] = UNKNOWN;
+        }
+    }
+    vertex_array = UNKNOWN;
+    cull_face = 0;
+    capabilities.clear();
+}
+
+void GLStateTracker::endFrame() {
+    if (++frames < REPORT_FRAMES) {
+        return;
+    }
+    std::cout << "GL state changes per frame: " << (double)issued / frames
+              << " issued, " << (double)filtered / frames
+              << " filtered as redundant" << std::endl;
+    frames = 0;
+    issued = 0;
+    filtered = 0;
+}
+
+GLStateTracker& gl_state() {
+    static GLStateTracker tracker;
+    return tracker;
+}
@@ -0,0 +1,215 @@
+#include "internal/hotreload.h"
+#include "internal/shadercache.h"
+
+#include <chrono>
+#include <iostream>
+
+// Copies the value of every non-array uniform active in both programs, so a
+// rebuilt program starts with the state the render loop set on the old one.
+static void copy_uniforms(GLuint from, GLuint to) {
+    GLint count = 0;
+    glGetProgramiv(from, GL_ACTIVE_UNIFORMS, &count);
+    glUseProgram(to);
+
+    for (GLint i = 0; i < count; i++) {
+        char name[256];
+        GLsizei length;
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(from, i, sizeof(name), &length, &size, &type, name);
+
+        GLint src = glGetUniformLocation(from, name);
+        GLint dst = glGetUniformLocation(to, name);
+        if (src < 0 || dst < 0 || size != 1) {
+            continue;
+        }
+
+        GLfloat f[16];
+        GLint n[4];
+        switch (type) {
+            case GL_FLOAT:
+                glGetUniformfv(from, src, f);
+                glUniform1fv(dst, 1, f);
+                break;
+            case GL_FLOAT_VEC2:
+                glGetUniformfv(from, src, f);
+                glUniform2fv(dst, 1, f);
+                break;
+            case GL_FLOAT_VEC3:
+                glGetUniformfv(from, src, f);
+                glUniform3fv(dst, 1, f);
+                break;
+            case GL_FLOAT_VEC4:
+                glGetUniformfv(from, src, f);
+                glUniform4fv(dst, 1, f);
+                break;
+            case GL_FLOAT_MAT3:
+                glGetUniformfv(from, src, f);
+                glUniformMatrix3fv(dst, 1, GL_FALSE, f);
+                break;
+            case GL_FLOAT_MAT4:
+                glGetUniformfv(from, src, f);
+                glUniformMatrix4fv(dst, 1, GL_FALSE, f);
+                break;
+            // samplers hold the texture unit they read from
+            case GL_INT:
+            case GL_BOOL:
+            case GL_SAMPLER_1D:
+            case GL_SAMPLER_2D:
+            case GL_SAMPLER_3D:
+            case GL_SAMPLER_CUBE:
+            case GL_SAMPLER_1D_SHADOW:
+            case GL_SAMPLER_2D_SHADOW:
+            case GL_SAMPLER_1D_ARRAY:
+            case GL_SAMPLER_2D_ARRAY:
+            case GL_SAMPLER_BUFFER:
+            case GL_INT_SAMPLER_2D:
+            case GL_INT_SAMPLER_BUFFER:
+            case GL_UNSIGNED_INT_SAMPLER_2D:
+            case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+                glGetUniformiv(from, src, n);
+                glUniform1iv(dst, 1, n);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+ShaderHotReloader::ShaderHotReloader(GLFWwindow* window) :
+    stopping(false) {
+    // invisible window whose context shares objects with the main one;
+    // windows can only be created on the main thread
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    shared_context = glfwCreateWindow(1, 1, "", NULL, window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+    if (!shared_context) {
+        std::cerr << "Failed to create shader reload context" << std::endl;
+    }
+}
+
+ShaderHotReloader::~ShaderHotReloader() {
+    stopping = true;
+    wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    ready.clear();
+    if (shared_context) {
+        glfwDestroyWindow(shared_context);
+    }
+}
+
+void ShaderHotReloader::watch(
+    cyGLSLProgram& program,
+    const char* vertex_path,
+    const char* fragment_path,
+    vector<string> watched_files,
+    std::function<void()> prepare,
+    std::function<void(cyGLSLProgram&)> register_uniforms
+) {
+    WatchEntry entry {
+        program,
+        vertex_path,
+        fragment_path,
+        watched_files,
+        prepare,
+        register_uniforms,
+        {}
+    };
+    for (const string& file : watched_files) {
+        std::error_code error;
+        auto write_time = std::filesystem::last_write_time(file, error);
+        entry.last_write.push_back(write_time);
+    }
+    entries.push_back(entry);
+}
+
+void ShaderHotReloader::start() {
+    if (!shared_context) {
+        return;
+    }
+    worker = std::thread(&ShaderHotReloader::run, this);
+}
+
+void ShaderHotReloader::apply() {
+    vector<ReadyProgram> programs;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        programs.swap(ready);
+    }
+
+    for (ReadyProgram& rebuilt : programs) {
+        GLuint old_id = rebuilt.target.GetID();
+        copy_uniforms(old_id, rebuilt.program->GetID());
+        // assigning below replaces the live object's uniform list with the
+        // rebuilt program's, which must be registered the same way first
+        if (rebuilt.register_uniforms) {
+            rebuilt.register_uniforms(*rebuilt.program);
+        }
+
+        // hand the new program's ID to the live object, then clear the
+        // temporary so its destructor doesn't delete it
+        rebuilt.target = *rebuilt.program;
+        *rebuilt.program = cyGLSLProgram();
+        glDeleteProgram(old_id);
+    }
+}
+
+bool ShaderHotReloader::hasChanged(WatchEntry& entry) {
+    bool changed = false;
+    for (size_t i = 0; i < entry.watched_files.size(); i++) {
+        std::error_code error;
+        auto write_time =
+            std::filesystem::last_write_time(entry.watched_files[i], error);
+        if (!error && write_time != entry.last_write[i]) {
+            entry.last_write[i] = write_time;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+void ShaderHotReloader::run() {
+    glfwMakeContextCurrent(shared_context);
+
+    while (!stopping) {
+        for (WatchEntry& entry : entries) {
+            if (!hasChanged(entry)) {
+                continue;
+            }
+
+            std::cout << "Reloading " << entry.fragment_path << std::endl;
+            if (entry.prepare) {
+                entry.prepare();
+            }
+
+            auto program = std::make_unique<cyGLSLProgram>();
+            bool built = build_program_cached(
+                *program,
+                entry.vertex_path.c_str(),
+                entry.fragment_path.c_str()
+            );
+            if (!built) {
+                std::cerr << "Keeping previous " << entry.fragment_path
+                          << std::endl;
+                continue;
+            }
+
+            // the render thread may only use the program once it's complete
+            glFinish();
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.push_back(
+                {entry.program, std::move(program), entry.register_uniforms}
+            );
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait_for(lock, std::chrono::milliseconds(POLL_INTERVAL_MS), [&] {
+            return stopping.load();
+        });
+    }
+
+    glfwMakeContextCurrent(NULL);
+}
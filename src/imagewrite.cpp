@@ -0,0 +1,244 @@
+#include "internal/imagewrite.h"
+#include "internal/parallel.h"
+#include "lodepng.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+bool write_rgba_png(
+    const std::string& path,
+    const unsigned char* rgba,
+    int width,
+    int height
+) {
+    unsigned error = lodepng::encode(path, rgba, width, height);
+    if (error) {
+        std::cout << "Failed to save " << path << ": "
+                  << lodepng_error_text(error) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static unsigned palette_bit_depth(size_t colors) {
+    if (colors <= 2) {
+        return 1;
+    }
+    if (colors <= 4) {
+        return 2;
+    }
+    if (colors <= 16) {
+        return 4;
+    }
+    return 8;
+}
+
+bool write_indexed_png(
+    const std::string& path,
+    const uint8_t* indices,
+    int width,
+    int height,
+    const Palette& palette
+) {
+    if (palette.size() > 256) {
+        std::cout << "Failed to save " << path << ": " << palette.size()
+                  << " colors don't fit an indexed PNG" << std::endl;
+        return false;
+    }
+
+    lodepng::State state;
+    // indices are handed over one per byte and packed to the PNG's depth
+    state.info_raw.colortype = LCT_PALETTE;
+    state.info_raw.bitdepth = 8;
+    state.info_png.color.colortype = LCT_PALETTE;
+    state.info_png.color.bitdepth = palette_bit_depth(palette.size());
+    // keep the file's color order instead of letting lodepng re-derive one
+    state.encoder.auto_convert = 0;
+    for (const std::array<uint8_t, 3>& c : palette.srgb) {
+        lodepng_palette_add(&state.info_raw, c[0], c[1], c[2], 255);
+        lodepng_palette_add(&state.info_png.color, c[0], c[1], c[2], 255);
+    }
+
+    std::vector<unsigned char> png;
+    unsigned error = lodepng::encode(png, indices, width, height, state);
+    if (!error) {
+        error = lodepng::save_file(png, path);
+    }
+    if (error) {
+        std::cout << "Failed to save " << path << ": "
+                  << lodepng_error_text(error) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// GIF color tables hold a power of two colors, at least two
+static int gif_table_bits(size_t colors) {
+    int bits = 1;
+    while (((size_t)1 << bits) < colors) {
+        bits++;
+    }
+    return bits;
+}
+
+// Variable-width LZW codes, packed least significant bit first.
+class GifCodeWriter {
+  public:
+    std::vector<uint8_t> bytes;
+
+    void write(int code, int size) {
+        bits |= (uint32_t)code << bit_count;
+        bit_count += size;
+        while (bit_count >= 8) {
+            bytes.push_back(bits & 0xff);
+            bits >>= 8;
+            bit_count -= 8;
+        }
+    }
+
+    void flush() {
+        if (bit_count > 0) {
+            bytes.push_back(bits & 0xff);
+        }
+        bits = 0;
+        bit_count = 0;
+    }
+
+  private:
+    uint32_t bits = 0;
+    int bit_count = 0;
+};
+
+// LZW image data for one frame, before it is split into sub-blocks.
+static std::vector<uint8_t>
+gif_lzw_encode(const std::vector<uint8_t>& indices, int min_code_size) {
+    const int MAX_CODE = 4095;
+    const int clear_code = 1 << min_code_size;
+    const int end_code = clear_code + 1;
+
+    // child code of each (code, index) string, 0 for none; indexed directly
+    // since a frame has far more pixels than the table has entries
+    std::vector<uint16_t> children((MAX_CODE + 1) * 256, 0);
+    int code_size = min_code_size + 1;
+    int last_code = end_code;
+
+    GifCodeWriter out;
+    out.bytes.reserve(indices.size() / 2);
+    out.write(clear_code, code_size);
+
+    int current = -1;
+    for (uint8_t index : indices) {
+        if (current < 0) {
+            current = index;
+            continue;
+        }
+        uint16_t& child = children[current * 256 + index];
+        if (child) {
+            current = child;
+            continue;
+        }
+
+        out.write(current, code_size);
+        child = ++last_code;
+        if (last_code >= (1 << code_size)) {
+            code_size++;
+        }
+        if (last_code == MAX_CODE) {
+            // table full: start over rather than let the ratio degrade
+            out.write(clear_code, code_size);
+            std::fill(children.begin(), children.end(), 0);
+            code_size = min_code_size + 1;
+            last_code = end_code;
+        }
+        current = index;
+    }
+    if (current >= 0) {
+        out.write(current, code_size);
+    }
+    out.write(end_code, code_size);
+    out.flush();
+    return std::move(out.bytes);
+}
+
+static void write_u16(std::ofstream& file, int value) {
+    file.put(value & 0xff);
+    file.put((value >> 8) & 0xff);
+}
+
+bool write_indexed_gif(
+    const std::string& path,
+    const std::vector<std::vector<uint8_t>>& frames,
+    int width,
+    int height,
+    const Palette& palette,
+    int delay
+) {
+    if (palette.size() > 256) {
+        std::cout << "Failed to save " << path << ": " << palette.size()
+                  << " colors don't fit a GIF" << std::endl;
+        return false;
+    }
+
+    int table_bits = gif_table_bits(palette.size());
+    int min_code_size = std::max(2, table_bits);
+
+    std::vector<std::vector<uint8_t>> encoded(frames.size());
+    parallel_for(frames.size(), [&](size_t i) {
+        encoded[i] = gif_lzw_encode(frames[i], min_code_size);
+    });
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "Failed to save " << path << ": can't open for writing"
+                  << std::endl;
+        return false;
+    }
+
+    file.write("GIF89a", 6);
+    write_u16(file, width);
+    write_u16(file, height);
+    // global color table, 8 bits per channel, table size
+    file.put(0x80 | (7 << 4) | (table_bits - 1));
+    file.put(0); // background color
+    file.put(0); // square pixels
+    for (int i = 0; i < (1 << table_bits); i++) {
+        for (int channel = 0; channel < 3; channel++) {
+            file.put(i < (int)palette.size() ? palette.srgb[i][channel] : 0);
+        }
+    }
+
+    // NETSCAPE2.0 application extension: loop forever
+    file.write("\x21\xff\x0bNETSCAPE2.0\x03\x01\x00\x00\x00", 19);
+
+    for (const std::vector<uint8_t>& data : encoded) {
+        // graphic control extension: leave the frame in place, no
+        // transparency
+        file.write("\x21\xf9\x04\x04", 4);
+        write_u16(file, delay);
+        file.write("\x00\x00", 2);
+
+        // image descriptor covering the whole canvas, no local color table
+        file.put(0x2c);
+        write_u16(file, 0);
+        write_u16(file, 0);
+        write_u16(file, width);
+        write_u16(file, height);
+        file.put(0);
+
+        file.put(min_code_size);
+        for (size_t offset = 0; offset < data.size(); offset += 255) {
+            size_t block = std::min<size_t>(255, data.size() - offset);
+            file.put(block);
+            file.write((const char*)data.data() + offset, block);
+        }
+        file.put(0);
+    }
+    file.put(0x3b);
+
+    if (!file) {
+        std::cout << "Failed to save " << path << ": write error" << std::endl;
+        return false;
+    }
+    return true;
+}
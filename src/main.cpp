@@ -16,11 +16,45 @@
 #include "internal/scene.h"
 #include "internal/pixelartfx.h"
 #include "internal/paletteparser.h"
+#include "internal/resolution.h"
+#include "internal/framepacer.h"
+#include "internal/hotreload.h"
+#include "internal/palettescore.h"
+#include "internal/frameexport.h"
+#include "internal/glstate.h"
+#include "lodepng.h"
 
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
-void compile_palette_into_fragshader(char** argv);
-void animate_light(SpotLight& light, cyGLSLProgram& mesh_program);
+// animate_light's path repeats after this long
+const double LIGHT_LOOP_SECONDS = 10 * M_PI;
+// time per exported GIF frame, in hundredths of a second
+const int EXPORT_FRAME_DELAY = 4;
+
+bool compile_palette_into_fragshader(char** argv, bool srgb);
+void animate_light(
+    SpotLight& light,
+    cyGLSLProgram& mesh_program,
+    double seconds
+);
+int export_turntable(
+    const char* path,
+    int frame_count,
+    GLFWwindow* window,
+    ShaderPrograms& programs,
+    Scene& scene,
+    PixelArtEffect& pixel_effect,
+    const Palette& palette
+);
+void load_batch_palettes(
+    const char* list_path,
+    bool srgb,
+    PixelArtEffect& pixel_effect
+);
+int score_reference_image(const char* dir, const char* png_path, bool srgb);
 
 int main(int argc, char** argv) {
     if (argc < 2) {
@@ -30,39 +64,204 @@ int main(int argc, char** argv) {
         exit(1);
     }
 
-    compile_palette_into_fragshader(argv);
+    // needed before the palette is compiled and the window is created
+    bool srgb = false;
+    const char* score_dir = nullptr;
+    const char* score_image = nullptr;
+    const char* scene_path = "./scenes/default.scene";
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--srgb") == 0) {
+            srgb = true;
+        } else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+            scene_path = argv[++i];
+        } else if (strcmp(argv[i], "--score-palettes") == 0 && i + 1 < argc) {
+            score_dir = argv[++i];
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                score_image = argv[++i];
+            }
+        }
+    }
+
+    // a reference image is scored without opening a window at all
+    if (score_dir && score_image) {
+        return score_reference_image(score_dir, score_image, srgb);
+    }
+
+    if (!compile_palette_into_fragshader(argv, srgb)) {
+        exit(1);
+    }
 
-    GLFWwindow* window = initAndCreateWindow();
+    GLFWwindow* window = initAndCreateWindow(srgb);
     ShaderPrograms programs = build_programs();
-    Scene scene(programs, window);
+    Scene scene(programs, window, scene_path);
 
-    PixelArtEffect
-        pixel_effect(window, 6, programs.pixelart, programs.upscale, scene);
+    PixelArtEffect pixel_effect(
+        window,
+        6,
+        programs.pixelart,
+        programs.upscale,
+        scene,
+        srgb
+    );
+
+    ResolutionController resolution(16.6);
+    FramePacer pacer;
+    bool hot_reload_enabled = false;
+    const char* export_path = nullptr;
+    int export_frame_count = 60;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--dynamic-resolution") == 0) {
+            resolution.enabled = true;
+            if (i + 1 < argc && atof(argv[i + 1]) > 0) {
+                resolution.target_frame_ms = atof(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--shadow-size") == 0 && i + 1 < argc) {
+            scene.fixed_shadow_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shadow-depth16") == 0) {
+            scene.shadow_depth_format = GL_DEPTH_COMPONENT16;
+        } else if (strcmp(argv[i], "--swap-interval") == 0 && i + 1 < argc) {
+            pacer.setSwapInterval(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--fps-limit") == 0 && i + 1 < argc) {
+            pacer.setFrameLimit(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--hot-reload") == 0) {
+            hot_reload_enabled = true;
+        } else if (strcmp(argv[i], "--packed-draws") == 0) {
+            scene.enablePackedDraws();
+        } else if (strcmp(argv[i], "--no-lod") == 0) {
+            scene.use_lods = false;
+        } else if (strcmp(argv[i], "--indexed-output") == 0) {
+            pixel_effect.indexed_output = true;
+        } else if (strcmp(argv[i], "--palette-batch") == 0 && i + 1 < argc) {
+            load_batch_palettes(argv[++i], srgb, pixel_effect);
+        } else if (strcmp(argv[i], "--export-turntable") == 0
+                   && i + 1 < argc) {
+            export_path = argv[++i];
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+                export_frame_count = atoi(argv[++i]);
+            }
+        }
+    }
+
+    if (export_path) {
+        PaletteParser parser;
+        Palette palette;
+        std::string error;
+        if (!parser.load(argv[1], srgb, palette, error)) {
+            std::cerr << "Failed to load palette " << error << std::endl;
+            exit(1);
+        }
+        int result = export_turntable(
+            export_path,
+            export_frame_count,
+            window,
+            programs,
+            scene,
+            pixel_effect,
+            palette
+        );
+        glfwTerminate();
+        return result;
+    }
+
+    std::unique_ptr<ShaderHotReloader> hot_reload;
+    if (hot_reload_enabled) {
+        hot_reload = std::make_unique<ShaderHotReloader>(window);
+        hot_reload->watch(
+            programs.mesh,
+            "./shaders/mesh.vert",
+            "./shaders/mesh.frag",
+            {"./shaders/mesh.vert", "./shaders/mesh.frag"}
+        );
+        hot_reload->watch(
+            programs.shadow,
+            "./shaders/shadow.vert",
+            "./shaders/shadow.frag",
+            {"./shaders/shadow.vert", "./shaders/shadow.frag"}
+        );
+        hot_reload->watch(
+            programs.pixelart,
+            "./shaders/pixelart.vert",
+            "./shaders/pixelart-compiled.frag",
+            {"./shaders/pixelart.vert", "./shaders/pixelart.frag"},
+            [argv, srgb] { compile_palette_into_fragshader(argv, srgb); }
+        );
+        hot_reload->watch(
+            programs.upscale,
+            "./shaders/upscale.vert",
+            "./shaders/upscale.frag",
+            {"./shaders/upscale.vert", "./shaders/upscale.frag"}
+        );
+        hot_reload->start();
+    }
 
     while (!glfwWindowShouldClose(window)) {
-        process_input(window, pixel_effect);
-        update_camera(window, programs);
-        animate_light(scene.light, programs.mesh);
+        // pace before sampling input so the wait doesn't add latency
+        pacer.waitForNextFrame();
+        glfwPollEvents();
+        pacer.markInput();
 
-        scene.drawShadowMap();
+        if (hot_reload) {
+            hot_reload->apply();
+        }
+
+        resolution.beginFrame();
+
+        process_input(window, pixel_effect, resolution);
+        resolution.applyScale(pixel_effect);
+        scene.view_projection = update_camera(window, programs);
+        if (!scene.light_fixed) {
+            animate_light(scene.light, programs.mesh, glfwGetTime());
+        }
+        scene.animate(glfwGetTime());
 
         pixel_effect.setFramebufferSize();
+        scene.fitShadowMap(
+            pixel_effect.GetBaseWidth(),
+            pixel_effect.GetBaseHeight(),
+            pixel_effect.GetHeight()
+        );
+
+        scene.drawShadowMap();
 
         pixel_effect.beginRender();
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         scene.drawMeshes();
         pixel_effect.endRender();
 
+        if (score_dir) {
+            std::vector<unsigned char> rgba = pixel_effect.readSceneColor();
+            ScoringReference reference(
+                rgba.data(),
+                pixel_effect.GetWidth(),
+                pixel_effect.GetHeight(),
+                srgb
+            );
+            print_palette_ranking(
+                score_palettes(reference, list_palette_files(score_dir), srgb)
+            );
+            break;
+        }
+
+        resolution.endFrame();
+        gl_state().endFrame();
+
         glfwSwapBuffers(window);
-        glfwPollEvents();
+        pacer.markPresent();
     }
 
+    hot_reload.reset();
+    pixel_effect.recorder.stop(); // needs the context for its last readbacks
     glfwTerminate();
     return 0;
 }
 
-void compile_palette_into_fragshader(char** argv) {
-    std::string palette_str = PaletteParser::generate_code_insert(argv[1]);
+bool compile_palette_into_fragshader(char** argv, bool srgb) {
+    std::string palette_str, error;
+    bool loaded =
+        PaletteParser::generate_code_insert(argv[1], srgb, palette_str, error);
+    if (!loaded) {
+        std::cerr << "Failed to load palette " << error << std::endl;
+        return false;
+    }
     std::ifstream inFile("./shaders/pixelart.frag");
     std::ofstream outFile("./shaders/pixelart-compiled.frag");
 
@@ -78,14 +277,131 @@ void compile_palette_into_fragshader(char** argv) {
         inFile.close();
         outFile.close();
     }
+    return true;
+}
+
+void load_batch_palettes(
+    const char* list_path,
+    bool srgb,
+    PixelArtEffect& pixel_effect
+) {
+    std::ifstream list(list_path);
+    if (!list.is_open()) {
+        std::cerr << "Failed to open palette list: " << list_path << std::endl;
+        exit(1);
+    }
+
+    PaletteParser parser;
+    std::vector<Palette> palettes;
+    std::string path, error;
+    while (std::getline(list, path)) {
+        if (path.empty()) {
+            continue;
+        }
+        Palette palette;
+        if (!parser.load(path, srgb, palette, error)) {
+            std::cerr << "Skipping batch palette " << error << std::endl;
+            continue;
+        }
+        std::cout << "Batch palette " << palettes.size() << ": " << path
+                  << std::endl;
+        palettes.push_back(std::move(palette));
+    }
+    pixel_effect.setBatchPalettes(palettes);
+}
+
+int score_reference_image(const char* dir, const char* png_path, bool srgb) {
+    std::vector<unsigned char> rgba;
+    unsigned width, height;
+    unsigned error = lodepng::decode(rgba, width, height, png_path);
+    if (error) {
+        std::cerr << "Error loading reference image: "
+                  << lodepng_error_text(error) << std::endl;
+        return 1;
+    }
+
+    ScoringReference reference(rgba.data(), width, height, srgb);
+    print_palette_ranking(
+        score_palettes(reference, list_palette_files(dir), srgb)
+    );
+    return 0;
+}
+
+// Renders one camera revolution with the light going once around its loop,
+// at fixed steps rather than wall-clock time, and exports the frames.
+int export_turntable(
+    const char* path,
+    int frame_count,
+    GLFWwindow* window,
+    ShaderPrograms& programs,
+    Scene& scene,
+    PixelArtEffect& pixel_effect,
+    const Palette& palette
+) {
+    auto start = std::chrono::steady_clock::now();
+
+    // the sink runs on the recorder's thread; frames is only read after
+    // stop() has joined it
+    std::vector<CapturedFrame> frames;
+    pixel_effect.recorder.lossless = true;
+    pixel_effect.recorder.start([&frames](const CapturedFrame& frame) {
+        frames.push_back(frame);
+    });
+
+    for (int i = 0; i < frame_count && !glfwWindowShouldClose(window); i++) {
+        glfwPollEvents();
+        double t = (double)i / frame_count;
+
+        scene.view_projection = update_camera(window, programs);
+        if (!scene.light_fixed) {
+            animate_light(scene.light, programs.mesh, t * LIGHT_LOOP_SECONDS);
+        }
+        scene.animate(t * LIGHT_LOOP_SECONDS);
+
+        pixel_effect.setFramebufferSize();
+        scene.fitShadowMap(
+            pixel_effect.GetBaseWidth(),
+            pixel_effect.GetBaseHeight(),
+            pixel_effect.GetHeight()
+        );
+        scene.drawShadowMap();
+        pixel_effect.beginRender();
+        scene.drawMeshes();
+        pixel_effect.endRender();
+        gl_state().endFrame();
+
+        glfwSwapBuffers(window);
+        orbit_camera(2 * M_PI / frame_count);
+    }
+    pixel_effect.recorder.stop();
+    auto rendered = std::chrono::steady_clock::now();
+
+    bool saved = export_frames(path, frames, palette, EXPORT_FRAME_DELAY);
+    auto finished = std::chrono::steady_clock::now();
+
+    using ms = std::chrono::duration<double, std::milli>;
+    std::cout << "Turntable: " << frames.size() << " frames rendered in "
+              << ms(rendered - start).count() << " ms, "
+              << ms(finished - start).count() << " ms wall time in total"
+              << std::endl;
+    if (!saved) {
+        return 1;
+    }
+    std::cout << "Saved " << path << std::endl;
+    return 0;
 }
 
-void animate_light(SpotLight& light, cyGLSLProgram& mesh_program) {
-    double time = glfwGetTime() / 5.0;
-    double time2 = glfwGetTime() * 4;
+void animate_light(
+    SpotLight& light,
+    cyGLSLProgram& mesh_program,
+    double seconds
+) {
+    double time = seconds / 5.0;
+    double time2 = seconds * 4;
 
-    light.origin =
-        cyVec3f(sin(time) * 60, cos(time) * 60, 35 + 10 * cos(time2));
+    // circles above the scene file's light target
+    light.origin = light.lookat
+        + cyVec3f(sin(time) * 60, cos(time) * 60, 35 + 10 * cos(time2));
     light.updateMVP();
     light.updateUniforms();
 }
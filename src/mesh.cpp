@@ -3,40 +3,129 @@
 #include <cy/cyGL.h>
 
 #include "internal/mesh.h"
+#include "internal/glstate.h"
+#include "internal/paletteparser.h"
 
-Mesh::Mesh(MeshData mesh_data, bool casts_shadow) :
+#include <algorithm>
+#include <cmath>
+
+static cyVec3f oklab_from_rgb(cyVec3f rgb) {
+    Color3f oklab = oklab_from_rgb(Color3f {rgb.x, rgb.y, rgb.z});
+    return cyVec3f(oklab.x, oklab.y, oklab.z);
+}
+
+GoochTones::GoochTones(
+    cyVec3f cool_rgb,
+    cyVec3f warm_rgb,
+    float alpha,
+    float beta
+) :
+    cool_oklab(oklab_from_rgb(cool_rgb)),
+    warm_oklab(oklab_from_rgb(warm_rgb)),
+    alpha(alpha),
+    beta(beta) {}
+
+Mesh::Mesh(
+    MeshData mesh_data,
+    MaterialData material,
+    int transform,
+    int material_index,
+    bool casts_shadow,
+    GoochTones gooch
+) :
     mesh_data(mesh_data),
-    casts_shadow(casts_shadow) {}
-
-void Mesh::draw() {
-    glBindVertexArray(mesh_data.VAO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh_data.EBO);
-    glDrawElements(GL_TRIANGLES, mesh_data.numFaces * 3, GL_UNSIGNED_INT, 0);
-}
-
-void Mesh::bindMaterialProperties(cyGLSLProgram& program) {
-    if (mesh_data.mesh.NM() > 0) {
-        cyTriMesh::Mtl objMaterial = mesh_data.mesh.M(0);
-
-        program.SetUniform3("BaseColor", objMaterial.Kd);
-        program.SetUniform3("SpecularColor", objMaterial.Ks);
-        program.SetUniform("Shine", objMaterial.Ns);
-        program.SetUniform3("Ambient", objMaterial.Ka);
-    } else {
-        float kd_default[3] = {0.15, 0.15, 0.45};
-        float ks_default[3] = {0.65, 0.65, 0.65};
-        float ns_default = 90.0;
-        float ka_default[3] = {0.21, 0.21, 0.21};
-
-        program.SetUniform3("BaseColor", kd_default);
-        program.SetUniform3("SpecularColor", ks_default);
-        program.SetUniform("Shine", ns_default);
-        program.SetUniform3("Ambient", ka_default);
+    material(material),
+    transform(transform),
+    material_index(material_index),
+    bound_min(mesh_data.bound_min),
+    bound_max(mesh_data.bound_max),
+    casts_shadow(casts_shadow),
+    gooch(gooch) {}
+
+void Mesh::updateBounds(const cyMatrix4f& world) {
+    // box around the transformed corners of the model-space box
+    bound_min = cyVec3f(INFINITY, INFINITY, INFINITY);
+    bound_max = -bound_min;
+    for (int corner = 0; corner < 8; corner++) {
+        cyVec3f p(
+            corner & 1 ? mesh_data.bound_max.x : mesh_data.bound_min.x,
+            corner & 2 ? mesh_data.bound_max.y : mesh_data.bound_min.y,
+            corner & 4 ? mesh_data.bound_max.z : mesh_data.bound_min.z
+        );
+        cyVec4f moved = world * p;
+        p = cyVec3f(moved.x, moved.y, moved.z);
+        bound_min = cyVec3f(
+            std::min(bound_min.x, p.x),
+            std::min(bound_min.y, p.y),
+            std::min(bound_min.z, p.z)
+        );
+        bound_max = cyVec3f(
+            std::max(bound_max.x, p.x),
+            std::max(bound_max.y, p.y),
+            std::max(bound_max.z, p.z)
+        );
     }
 }
 
-void Mesh::cleanup() {
-    glDeleteBuffers(1, &this->mesh_data.VBO);
-    glDeleteBuffers(1, &this->mesh_data.EBO);
-    glDeleteVertexArrays(1, &this->mesh_data.VAO);
+int Mesh::selectLOD(
+    const cyMatrix4f& view_projection,
+    float viewport_height,
+    float max_error
+) const {
+    cyVec4f center = view_projection * ((bound_min + bound_max) / 2);
+    if (center.w <= 0) {
+        return 0; // behind the viewer; only reached when not culled
+    }
+    // the Y row's length is the projection's vertical scale, whatever the
+    // view's rotation; dividing by w gives NDC per world unit at the center
+    const float* m = view_projection.cell;
+    float y_scale = sqrtf(m[1] * m[1] + m[5] * m[5] + m[9] * m[9]);
+    float pixels_per_unit = y_scale / center.w * viewport_height / 2;
+
+    // errors are in model units; the world bounds' size gives the scale
+    // (slightly overestimated when the placement is rotated)
+    float model_size = (mesh_data.bound_max - mesh_data.bound_min).Length();
+    float world_size = (bound_max - bound_min).Length();
+    float scale = model_size > 0 ? world_size / model_size : 1;
+
+    for (int lod = mesh_data.lod_count - 1; lod > 0; lod--) {
+        float error = mesh_data.lods[lod].error * scale * pixels_per_unit;
+        if (error <= max_error) {
+            return lod;
+        }
+    }
+    return 0;
+}
+
+void Mesh::draw(int lod) {
+    // the VAO already holds the element buffer; meshes made from the same
+    // OBJ share it, so consecutive ones skip the bind
+    gl_state().bindVertexArray(mesh_data.VAO);
+    drawElements(lod);
+}
+
+void Mesh::drawDepth(int lod) {
+    gl_state().bindVertexArray(mesh_data.depth_VAO);
+    drawElements(lod);
+}
+
+void Mesh::drawElements(int lod) {
+    const MeshLOD& range = mesh_data.lods[lod];
+    glDrawElements(
+        GL_TRIANGLES,
+        range.index_count,
+        GL_UNSIGNED_INT,
+        (void*)(range.first_index * sizeof(unsigned int))
+    );
+}
+
+void Mesh::bindDraw() {
+    // the per-mesh VAOs leave this attribute's array disabled, so every
+    // vertex reads this constant
+    glVertexAttribI2i(DRAW_ATTRIBUTE, transform, material_index);
+}
+
+void Mesh::bindTextures() {
+    gl_state().bindTexture(0, GL_TEXTURE_2D, material.diffuse_texture);
+    gl_state().bindTexture(1, GL_TEXTURE_2D, material.specular_texture);
 }
@@ -0,0 +1,544 @@
+#include "internal/meshlod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <queue>
+#include <sstream>
+#include <thread>
+
+using std::string;
+using std::vector;
+
+const char* MESH_CACHE_DIR = "./mesh_cache";
+// bump when the simplifier changes, so stale levels aren't reused
+const uint32_t LOD_CACHE_VERSION = 1;
+
+const size_t LOD_REDUCTION = 4; // triangles kept per level: 1 in 4
+const size_t MIN_LOD_TRIANGLES = 64;
+// a collapse may turn a neighbouring triangle at most this far (cosine)
+const double MIN_NORMAL_DOT = 0.2;
+
+// Sum of squared distances to a set of planes, each weighted by its
+// triangle's area, as the symmetric 4x4 matrix's upper triangle.
+struct Quadric {
+    double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+    double area;
+
+    void addPlane(double nx, double ny, double nz, double d, double weight) {
+        xx += weight * nx * nx;
+        xy += weight * nx * ny;
+        xz += weight * nx * nz;
+        xw += weight * nx * d;
+        yy += weight * ny * ny;
+        yz += weight * ny * nz;
+        yw += weight * ny * d;
+        zz += weight * nz * nz;
+        zw += weight * nz * d;
+        ww += weight * d * d;
+        area += weight;
+    }
+
+    Quadric operator+(const Quadric& o) const {
+        return {
+            xx + o.xx,
+            xy + o.xy,
+            xz + o.xz,
+            xw + o.xw,
+            yy + o.yy,
+            yz + o.yz,
+            yw + o.yw,
+            zz + o.zz,
+            zw + o.zw,
+            ww + o.ww,
+            area + o.area
+        };
+    }
+
+    double evaluate(const float* p) const {
+        double x = p[0], y = p[1], z = p[2];
+        return xx * x * x + 2 * xy * x * y + 2 * xz * x * z + 2 * xw * x
+            + yy * y * y + 2 * yz * y * z + 2 * yw * y + zz * z * z
+            + 2 * zw * z + ww;
+    }
+};
+
+static void cross(const float* a, const float* b, const float* c, double* n) {
+    double ux = b[0] - a[0], uy = b[1] - a[1], uz = b[2] - a[2];
+    double vx = c[0] - a[0], vy = c[1] - a[1], vz = c[2] - a[2];
+    n[0] = uy * vz - uz * vy;
+    n[1] = uz * vx - ux * vz;
+    n[2] = ux * vy - uy * vx;
+}
+
+// Half-edge collapses in order of quadric cost. Candidates sit in a heap
+// and are checked against the current mesh when popped, so a collapse
+// never has to find and fix up the entries it made stale.
+class EdgeCollapser {
+  public:
+    EdgeCollapser(
+        const vector<float>& vertices,
+        int stride,
+        const vector<unsigned int>& indices
+    );
+
+    // Stops early when no remaining edge can collapse.
+    void collapseTo(size_t target_triangles);
+
+    size_t triangleCount() const {
+        return live_triangles;
+    }
+
+    float error() const {
+        return max_error;
+    }
+
+    vector<unsigned int> indices() const;
+
+  private:
+    struct Candidate {
+        double cost;
+        unsigned int from, to;
+
+        bool operator>(const Candidate& o) const {
+            return cost > o.cost;
+        }
+    };
+
+    const vector<float>& vertices;
+    int stride;
+    vector<unsigned int> triangles; // three vertices each
+    vector<bool> triangle_alive;
+    size_t live_triangles;
+    vector<vector<unsigned int>> triangles_of; // per vertex
+    vector<Quadric> quadrics;
+    vector<bool> locked;
+    std::priority_queue<Candidate, vector<Candidate>, std::greater<Candidate>>
+        heap;
+    float max_error;
+
+    const float* position(unsigned int v) const {
+        return vertices.data() + (size_t)v * stride;
+    }
+
+    bool contains(unsigned int t, unsigned int v) const {
+        return triangles[3 * t] == v || triangles[3 * t + 1] == v
+            || triangles[3 * t + 2] == v;
+    }
+
+    double cost(unsigned int from, unsigned int to) const {
+        return (quadrics[from] + quadrics[to]).evaluate(position(to));
+    }
+
+    void lockBordersAndSeams(size_t vertex_count);
+    void push(unsigned int from, unsigned int to);
+    void pushEdges(unsigned int v);
+    void neighbours(unsigned int v, vector<unsigned int>& out) const;
+    bool canCollapse(unsigned int from, unsigned int to) const;
+    // Drops dead triangle t from its corners' lists, except from's, which
+    // the collapse clears anyway.
+    void forget(unsigned int t, unsigned int from);
+    void collapse(unsigned int from, unsigned int to, double cost);
+};
+
+EdgeCollapser::EdgeCollapser(
+    const vector<float>& vertices,
+    int stride,
+    const vector<unsigned int>& indices
+) :
+    vertices(vertices),
+    stride(stride),
+    live_triangles(0),
+    max_error(0) {
+    size_t vertex_count = vertices.size() / stride;
+    triangles_of.resize(vertex_count);
+    quadrics.assign(vertex_count, Quadric {});
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (a == b || b == c || a == c) {
+            continue;
+        }
+        unsigned int t = triangles.size() / 3;
+        triangles.insert(triangles.end(), {a, b, c});
+        triangle_alive.push_back(true);
+        live_triangles++;
+
+        double n[3];
+        cross(position(a), position(b), position(c), n);
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        for (unsigned int v : {a, b, c}) {
+            triangles_of[v].push_back(t);
+            if (length > 0) {
+                const float* p = position(a);
+                double nx = n[0] / length, ny = n[1] / length;
+                double nz = n[2] / length;
+                double d = -(nx * p[0] + ny * p[1] + nz * p[2]);
+                quadrics[v].addPlane(nx, ny, nz, d, length / 2);
+            }
+        }
+    }
+
+    lockBordersAndSeams(vertex_count);
+    for (size_t t = 0; t < triangle_alive.size(); t++) {
+        for (int corner = 0; corner < 3; corner++) {
+            unsigned int a = triangles[3 * t + corner];
+            unsigned int b = triangles[3 * t + (corner + 1) % 3];
+            push(a, b);
+            push(b, a);
+        }
+    }
+}
+
+void EdgeCollapser::lockBordersAndSeams(size_t vertex_count) {
+    locked.assign(vertex_count, false);
+
+    // an edge used by anything but exactly two triangles is an open border
+    // (or non-manifold); moving its ends would tear or shrink the mesh
+    vector<uint64_t> edges;
+    for (size_t t = 0; t < triangle_alive.size(); t++) {
+        for (int corner = 0; corner < 3; corner++) {
+            uint64_t a = triangles[3 * t + corner];
+            uint64_t b = triangles[3 * t + (corner + 1) % 3];
+            edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size();) {
+        size_t run = 1;
+        while (i + run < edges.size() && edges[i + run] == edges[i]) {
+            run++;
+        }
+        if (run != 2) {
+            locked[edges[i] >> 32] = true;
+            locked[edges[i] & 0xffffffff] = true;
+        }
+        i += run;
+    }
+
+    // vertices at the same position differ in their other attributes
+    // (a texture seam); collapsing one side would open a crack
+    vector<unsigned int> order(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++) {
+        order[v] = v;
+    }
+    auto less = [this](unsigned int a, unsigned int b) {
+        return std::lexicographical_compare(
+            position(a),
+            position(a) + 3,
+            position(b),
+            position(b) + 3
+        );
+    };
+    std::sort(order.begin(), order.end(), less);
+    for (size_t i = 1; i < order.size(); i++) {
+        if (!less(order[i - 1], order[i])) {
+            locked[order[i - 1]] = true;
+            locked[order[i]] = true;
+        }
+    }
+}
+
+void EdgeCollapser::push(unsigned int from, unsigned int to) {
+    if (!locked[from]) {
+        heap.push({cost(from, to), from, to});
+    }
+}
+
+void EdgeCollapser::pushEdges(unsigned int v) {
+    for (unsigned int t : triangles_of[v]) {
+        for (int corner = 0; corner < 3; corner++) {
+            unsigned int w = triangles[3 * t + corner];
+            if (w != v) {
+                push(v, w);
+                push(w, v);
+            }
+        }
+    }
+}
+
+void EdgeCollapser::neighbours(unsigned int v, vector<unsigned int>& out)
+    const {
+    out.clear();
+    for (unsigned int t : triangles_of[v]) {
+        for (int corner = 0; corner < 3; corner++) {
+            if (triangles[3 * t + corner] != v) {
+                out.push_back(triangles[3 * t + corner]);
+            }
+        }
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+bool EdgeCollapser::canCollapse(unsigned int from, unsigned int to) const {
+    size_t shared = 0;
+    for (unsigned int t : triangles_of[from]) {
+        if (contains(t, to)) {
+            shared++;
+        }
+    }
+    if (shared == 0) {
+        return false; // no longer an edge
+    }
+
+    // the link condition: the ends may only have the vertices opposite
+    // the edge in common, or the collapse pinches the surface
+    vector<unsigned int> from_ring, to_ring, common;
+    neighbours(from, from_ring);
+    neighbours(to, to_ring);
+    std::set_intersection(
+        from_ring.begin(),
+        from_ring.end(),
+        to_ring.begin(),
+        to_ring.end(),
+        std::back_inserter(common)
+    );
+    if (common.size() != shared) {
+        return false;
+    }
+
+    // no remaining triangle may flip or collapse to a sliver
+    for (unsigned int t : triangles_of[from]) {
+        if (contains(t, to)) {
+            continue;
+        }
+        const float* before[3];
+        const float* after[3];
+        for (int corner = 0; corner < 3; corner++) {
+            unsigned int v = triangles[3 * t + corner];
+            before[corner] = position(v);
+            after[corner] = position(v == from ? to : v);
+        }
+        double n0[3], n1[3];
+        cross(before[0], before[1], before[2], n0);
+        cross(after[0], after[1], after[2], n1);
+        double dot = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+        double lengths =
+            sqrt((n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2])
+                 * (n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]));
+        if (lengths == 0 || dot < MIN_NORMAL_DOT * lengths) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void EdgeCollapser::forget(unsigned int t, unsigned int from) {
+    for (int corner = 0; corner < 3; corner++) {
+        unsigned int v = triangles[3 * t + corner];
+        if (v != from) {
+            vector<unsigned int>& list = triangles_of[v];
+            list.erase(std::find(list.begin(), list.end(), t));
+        }
+    }
+}
+
+void EdgeCollapser::collapse(unsigned int from, unsigned int to, double cost) {
+    vector<unsigned int>& kept = triangles_of[to];
+    for (unsigned int t : triangles_of[from]) {
+        if (contains(t, to)) {
+            triangle_alive[t] = false;
+            live_triangles--;
+            forget(t, from);
+            continue;
+        }
+        for (int corner = 0; corner < 3; corner++) {
+            if (triangles[3 * t + corner] == from) {
+                triangles[3 * t + corner] = to;
+            }
+        }
+        kept.push_back(t);
+    }
+    triangles_of[from].clear();
+
+    Quadric merged = quadrics[from] + quadrics[to];
+    quadrics[to] = merged;
+    if (merged.area > 0) {
+        float error = sqrt(std::max(0.0, cost) / merged.area);
+        max_error = std::max(max_error, error);
+    }
+    pushEdges(to);
+}
+
+void EdgeCollapser::collapseTo(size_t target_triangles) {
+    while (live_triangles > target_triangles && !heap.empty()) {
+        Candidate candidate = heap.top();
+        heap.pop();
+        unsigned int from = candidate.from, to = candidate.to;
+        if (triangles_of[from].empty() || triangles_of[to].empty()) {
+            continue; // an end was collapsed away
+        }
+        // quadrics only grow, so a stale entry is never too expensive;
+        // re-queue it at its current cost
+        double current = cost(from, to);
+        if (current > candidate.cost * (1 + 1e-9) + 1e-18) {
+            heap.push({current, from, to});
+            continue;
+        }
+        if (canCollapse(from, to)) {
+            collapse(from, to, current);
+        }
+    }
+}
+
+vector<unsigned int> EdgeCollapser::indices() const {
+    vector<unsigned int> out;
+    out.reserve(live_triangles * 3);
+    for (size_t t = 0; t < triangle_alive.size(); t++) {
+        if (triangle_alive[t]) {
+            out.insert(
+                out.end(),
+                triangles.begin() + 3 * t,
+                triangles.begin() + 3 * t + 3
+            );
+        }
+    }
+    return out;
+}
+
+vector<LODIndices> build_lods(
+    const vector<float>& vertices,
+    int stride,
+    const vector<unsigned int>& indices
+) {
+    vector<LODIndices> lods = {{indices, 0.0f}};
+    EdgeCollapser collapser(vertices, stride, indices);
+    while (lods.size() < (size_t)MAX_LODS) {
+        size_t previous = lods.back().indices.size() / 3;
+        size_t target = previous / LOD_REDUCTION;
+        if (target < MIN_LOD_TRIANGLES) {
+            break;
+        }
+        collapser.collapseTo(target);
+        // locked borders and seams can stall it well short of the target
+        if (collapser.triangleCount() * 2 > previous) {
+            break;
+        }
+        lods.push_back({collapser.indices(), collapser.error()});
+    }
+    return lods;
+}
+
+// FNV-1a, so keys are stable between runs and builds
+static uint64_t hash_bytes(const void* data, size_t size, uint64_t hash) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static string lod_cache_path(
+    const string& obj_path,
+    const vector<float>& vertices,
+    int stride,
+    const vector<unsigned int>& indices
+) {
+    uint64_t hash = 14695981039346656037ull;
+    hash = hash_bytes(&LOD_CACHE_VERSION, sizeof(LOD_CACHE_VERSION), hash);
+    hash = hash_bytes(&stride, sizeof(stride), hash);
+    hash = hash_bytes(vertices.data(), vertices.size() * sizeof(float), hash);
+    hash = hash_bytes(
+        indices.data(),
+        indices.size() * sizeof(unsigned int),
+        hash
+    );
+
+    std::ostringstream path;
+    path << MESH_CACHE_DIR << "/"
+         << std::filesystem::path(obj_path).stem().string() << "-"
+         << std::hex << hash << ".lod";
+    return path.str();
+}
+
+static bool read_lod_cache(
+    const string& path,
+    size_t vertex_count,
+    vector<LODIndices>& lods
+) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    uint32_t count = 0;
+    if (!file.read((char*)&count, sizeof(count)) || count == 0
+        || count > (uint32_t)MAX_LODS) {
+        return false;
+    }
+    lods.resize(count);
+    for (LODIndices& lod : lods) {
+        uint32_t index_count = 0;
+        if (!file.read((char*)&lod.error, sizeof(lod.error))
+            || !file.read((char*)&index_count, sizeof(index_count))
+            || index_count % 3 != 0) {
+            return false;
+        }
+        lod.indices.resize(index_count);
+        if (!file.read(
+                (char*)lod.indices.data(),
+                index_count * sizeof(unsigned int)
+            )) {
+            return false;
+        }
+        for (unsigned int index : lod.indices) {
+            if (index >= vertex_count) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void
+write_lod_cache(const string& path, const vector<LODIndices>& lods) {
+    std::error_code error;
+    std::filesystem::create_directories(MESH_CACHE_DIR, error);
+
+    // written aside and renamed, so a reader never sees half a file
+    std::ostringstream temp_path;
+    temp_path << path << "." << std::hash<std::thread::id>()(
+        std::this_thread::get_id()
+    );
+    {
+        std::ofstream file(temp_path.str(), std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Failed to write mesh cache: " << path << std::endl;
+            return;
+        }
+        uint32_t count = lods.size();
+        file.write((const char*)&count, sizeof(count));
+        for (const LODIndices& lod : lods) {
+            uint32_t index_count = lod.indices.size();
+            file.write((const char*)&lod.error, sizeof(lod.error));
+            file.write((const char*)&index_count, sizeof(index_count));
+            file.write(
+                (const char*)lod.indices.data(),
+                index_count * sizeof(unsigned int)
+            );
+        }
+    }
+    std::filesystem::rename(temp_path.str(), path, error);
+}
+
+vector<LODIndices> load_lods(
+    const string& obj_path,
+    const vector<float>& vertices,
+    int stride,
+    const vector<unsigned int>& indices
+) {
+    string path = lod_cache_path(obj_path, vertices, stride, indices);
+    vector<LODIndices> lods;
+    if (read_lod_cache(path, vertices.size() / stride, lods)) {
+        return lods;
+    }
+    lods = build_lods(vertices, stride, indices);
+    write_lod_cache(path, lods);
+    return lods;
+}
@@ -0,0 +1,222 @@
+#include "internal/packedmeshes.h"
+#include "internal/glstate.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+const int FLOATS_PER_VERTEX = 8; // position, normal, texture coordinate
+
+// Binds buffer for reading back, without touching any VAO's element
+// buffer binding, and returns its size in bytes.
+static GLint bind_for_read(GLuint buffer) {
+    GLint size = 0;
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+    return size;
+}
+
+PackedMeshes::PackedMeshes(const std::vector<Mesh>& meshes) {
+    std::vector<float> vertices;
+    std::vector<GLint> draws;
+    std::vector<unsigned int> indices;
+    std::map<std::pair<GLuint, GLuint>, int> group_of;
+
+    for (const Mesh& mesh : meshes) {
+        const MeshData& data = mesh.mesh_data;
+        size_t first_vertex = vertices.size() / FLOATS_PER_VERTEX;
+        size_t first_index = indices.size();
+
+        GLint vertex_bytes = bind_for_read(data.VBO);
+        vertices.resize(vertices.size() + vertex_bytes / sizeof(float));
+        glGetBufferSubData(
+            GL_COPY_READ_BUFFER,
+            0,
+            vertex_bytes,
+            vertices.data() + first_vertex * FLOATS_PER_VERTEX
+        );
+
+        GLint index_bytes = bind_for_read(data.EBO);
+        indices.resize(indices.size() + index_bytes / sizeof(unsigned int));
+        glGetBufferSubData(
+            GL_COPY_READ_BUFFER,
+            0,
+            index_bytes,
+            indices.data() + first_index
+        );
+
+        size_t vertex_count = vertex_bytes / sizeof(float) / FLOATS_PER_VERTEX;
+        for (size_t v = 0; v < vertex_count; v++) {
+            draws.push_back(mesh.transform);
+            draws.push_back(mesh.material_index);
+        }
+
+        std::pair<GLuint, GLuint> textures(
+            mesh.material.diffuse_texture,
+            mesh.material.specular_texture
+        );
+        int group =
+            group_of.try_emplace(textures, group_of.size()).first->second;
+        Range range = {
+            {},
+            (GLint)first_vertex,
+            group,
+            textures.first,
+            textures.second
+        };
+        for (int lod = 0; lod < data.lod_count; lod++) {
+            range.lods[lod] = data.lods[lod];
+            range.lods[lod].first_index += first_index;
+        }
+        ranges.push_back(range);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    glGenVertexArrays(1, &VAO);
+    gl_state().bindVertexArray(VAO);
+
+    glGenBuffers(1, &VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(
+        GL_ARRAY_BUFFER,
+        vertices.size() * sizeof(float),
+        vertices.data(),
+        GL_STATIC_DRAW
+    );
+    const GLsizei stride = FLOATS_PER_VERTEX * sizeof(float);
+    // same locations as the mesh and shadow shaders declare
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(
+        1,
+        3,
+        GL_FLOAT,
+        GL_FALSE,
+        stride,
+        (void*)(3 * sizeof(float))
+    );
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(
+        2,
+        2,
+        GL_FLOAT,
+        GL_FALSE,
+        stride,
+        (void*)(6 * sizeof(float))
+    );
+    glEnableVertexAttribArray(2);
+
+    glGenBuffers(1, &draw_VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, draw_VBO);
+    glBufferData(
+        GL_ARRAY_BUFFER,
+        draws.size() * sizeof(GLint),
+        draws.data(),
+        GL_STATIC_DRAW
+    );
+    glVertexAttribIPointer(DRAW_ATTRIBUTE, 2, GL_INT, 0, (void*)0);
+    glEnableVertexAttribArray(DRAW_ATTRIBUTE);
+
+    glGenBuffers(1, &EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(
+        GL_ELEMENT_ARRAY_BUFFER,
+        indices.size() * sizeof(unsigned int),
+        indices.data(),
+        GL_STATIC_DRAW
+    );
+
+    std::vector<float> positions;
+    positions.reserve(vertices.size() / FLOATS_PER_VERTEX * 3);
+    for (size_t i = 0; i < vertices.size(); i += FLOATS_PER_VERTEX) {
+        positions.insert(
+            positions.end(),
+            vertices.begin() + i,
+            vertices.begin() + i + 3
+        );
+    }
+    glGenVertexArrays(1, &depth_VAO);
+    gl_state().bindVertexArray(depth_VAO);
+    glGenBuffers(1, &position_VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, position_VBO);
+    glBufferData(
+        GL_ARRAY_BUFFER,
+        positions.size() * sizeof(float),
+        positions.data(),
+        GL_STATIC_DRAW
+    );
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, draw_VBO);
+    glVertexAttribIPointer(DRAW_ATTRIBUTE, 2, GL_INT, 0, (void*)0);
+    glEnableVertexAttribArray(DRAW_ATTRIBUTE);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+    gl_state().bindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    bytes = (vertices.size() + positions.size()) * sizeof(float)
+        + draws.size() * sizeof(GLint) + indices.size() * sizeof(unsigned int);
+}
+
+PackedMeshes::~PackedMeshes() {
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &draw_VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &position_VBO);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteVertexArrays(1, &depth_VAO);
+}
+
+void PackedMeshes::draw(
+    const std::vector<int>& visible,
+    const std::vector<int>& lods,
+    bool by_texture
+) {
+    gl_state().bindVertexArray(by_texture ? VAO : depth_VAO);
+
+    order = visible;
+    if (by_texture) {
+        std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+            return ranges[a].texture_group < ranges[b].texture_group;
+        });
+    }
+
+    counts.clear();
+    offsets.clear();
+    base_vertices.clear();
+    for (size_t i = 0; i < order.size(); i++) {
+        const Range& range = ranges[order[i]];
+        const MeshLOD& lod = range.lods[lods[order[i]]];
+        counts.push_back(lod.index_count);
+        offsets.push_back((void*)(lod.first_index * sizeof(unsigned int)));
+        base_vertices.push_back(range.base_vertex);
+
+        bool group_ends = i + 1 == order.size()
+            || ranges[order[i + 1]].texture_group != range.texture_group;
+        if (by_texture && group_ends) {
+            gl_state().bindTexture(0, GL_TEXTURE_2D, range.diffuse_texture);
+            gl_state().bindTexture(1, GL_TEXTURE_2D, range.specular_texture);
+            submit();
+        }
+    }
+    if (!by_texture) {
+        submit();
+    }
+}
+
+void PackedMeshes::submit() {
+    if (!counts.empty()) {
+        glMultiDrawElementsBaseVertex(
+            GL_TRIANGLES,
+            counts.data(),
+            GL_UNSIGNED_INT,
+            offsets.data(),
+            counts.size(),
+            base_vertices.data()
+        );
+    }
+    counts.clear();
+    offsets.clear();
+    base_vertices.clear();
+}
@@ -1,37 +1,93 @@
 
 #include "internal/paletteparser.h"
-#include <iostream>
+#include "lodepng.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
 using std::string;
-using std::to_string;
-
-typedef struct vec3 {
-    float x, y, z;
-} vec3;
-
-// Function to convert a hex color string to RGB
-vec3 hex_to_rgb(const string& hex) {
-    // Remove '#' if present
-    string h = hex;
-    if (h[0] == '#') {
-        h = h.substr(1);
-    }
-
-    // Parse the hex string
-    int r = 0, g = 0, b = 0;
-    if (h.length() == 6) {
-        r = std::stoi(h.substr(0, 2), nullptr, 16);
-        g = std::stoi(h.substr(2, 2), nullptr, 16);
-        b = std::stoi(h.substr(4, 2), nullptr, 16);
-    } else {
-        std::cerr << "Malformed hex '" << hex
-                  << "'. Expecting a # followed by 6 characters." << std::endl;
-        exit(1);
+using std::string_view;
+
+static float exact_linear_from_srgb(float c) {
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float exact_srgb_from_linear(float c) {
+    return c <= 0.0031308f ? c * 12.92f
+                           : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+// Decoding has only 256 inputs, so it's a direct table. Encoding indexes a
+// 4096-entry table of already-rounded bytes: every 8-bit value survives a
+// decode/encode round trip, arbitrary inputs land within one code of the
+// exact powf result, and it runs several times faster than powf (all
+// checked by `make check`).
+struct SRGBTables {
+    static const int ENCODE_SIZE = 4096;
+    float decode[256];
+    uint8_t encode[ENCODE_SIZE];
+
+    SRGBTables() {
+        for (int i = 0; i < 256; i++) {
+            decode[i] = exact_linear_from_srgb(i / 255.0f);
+        }
+        for (int i = 0; i < ENCODE_SIZE; i++) {
+            float c = exact_srgb_from_linear(i / (float)(ENCODE_SIZE - 1));
+            encode[i] = (uint8_t)lroundf(c * 255.0f);
+        }
     }
-    return vec3(r / 255.0, g / 255.0, b / 255.0);
+};
+
+static const SRGBTables& srgb_tables() {
+    static const SRGBTables tables;
+    return tables;
+}
+
+float linear_from_srgb8(uint8_t encoded) {
+    return srgb_tables().decode[encoded];
+}
+
+uint8_t srgb8_from_linear(float linear) {
+    if (!(linear > 0.0f)) { // also catches NaN
+        return 0;
+    }
+    if (linear >= 1.0f) {
+        return 255;
+    }
+    const int last = SRGBTables::ENCODE_SIZE - 1;
+    return srgb_tables().encode[(int)(linear * last + 0.5f)];
+}
+
+// Cube root from an exponent-dividing bit trick plus one Halley step.
+// Over the whole 8-bit sRGB cube, oklab_from_rgb_fast stays within
+// 6e-5 (Euclidean Oklab distance) of oklab_from_rgb, far below a visible
+// difference, at roughly 3.4x the throughput of the cbrtf version
+// (checked by `make check`).
+float fast_cbrtf(float x) {
+    if (x == 0.0f) {
+        return 0.0f;
+    }
+    float a = fabsf(x);
+
+    uint32_t bits;
+    memcpy(&bits, &a, sizeof(bits));
+    bits = bits / 3 + 0x2a5137a0;
+    float y;
+    memcpy(&y, &bits, sizeof(y));
+
+    float y3 = y * y * y;
+    y *= (y3 + 2.0f * a) / (2.0f * y3 + a);
+
+    return copysignf(y, x);
 }
 
 // https://bottosson.github.io/misc/ok_color.h
-vec3 oklab_from_rgb(vec3 rgb) {
+template<float (*cube_root)(float)>
+static Color3f oklab_from_rgb_with(Color3f rgb) {
     float l =
         0.4122214708f * rgb.x + 0.5363325363f * rgb.y + 0.0514459929f * rgb.z;
     float m =
@@ -39,9 +95,9 @@ vec3 oklab_from_rgb(vec3 rgb) {
     float s =
         0.0883024619f * rgb.x + 0.2817188376f * rgb.y + 0.6299787005f * rgb.z;
 
-    float l_ = cbrtf(l);
-    float m_ = cbrtf(m);
-    float s_ = cbrtf(s);
+    float l_ = cube_root(l);
+    float m_ = cube_root(m);
+    float s_ = cube_root(s);
 
     return {
         0.2104542553f * l_ + 0.7936177850f * m_ - 0.0040720468f * s_,
@@ -50,34 +106,299 @@ vec3 oklab_from_rgb(vec3 rgb) {
     };
 }
 
-vec3 hex_to_oklab(const string& hex) {
-    return oklab_from_rgb(hex_to_rgb(hex));
+static float exact_cbrtf(float x) {
+    return cbrtf(x);
+}
+
+Color3f oklab_from_rgb(Color3f rgb) {
+    return oklab_from_rgb_with<exact_cbrtf>(rgb);
+}
+
+Color3f oklab_from_rgb_fast(Color3f rgb) {
+    return oklab_from_rgb_with<fast_cbrtf>(rgb);
+}
+
+void Palette::clear() {
+    srgb.clear();
+    oklab.clear();
+    by_lightness.clear();
+}
+
+// palettes are small; a PNG with more distinct colors than this is an image,
+// not a swatch strip
+const size_t MAX_PNG_COLORS = 256;
+
+static string_view trim(string_view s) {
+    size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == string_view::npos) {
+        return {};
+    }
+    size_t end = s.find_last_not_of(" \t\r");
+    return s.substr(begin, end - begin + 1);
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
 }
 
-string PaletteParser::generate_code_insert(const string& filename) {
-    string palette_txt = "const vec3[] PALETTE = vec3[](\n";
+// RRGGBB, #RRGGBB or AARRGGBB (Paint.NET; alpha is ignored)
+static bool parse_hex_color(string_view token, std::array<uint8_t, 3>& rgb) {
+    if (!token.empty() && token[0] == '#') {
+        token.remove_prefix(1);
+    }
+    if (token.size() == 8) {
+        token.remove_prefix(2);
+    } else if (token.size() != 6) {
+        return false;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        int high = hex_digit(token[2 * i]);
+        int low = hex_digit(token[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        rgb[i] = high * 16 + low;
+    }
+    return true;
+}
 
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open file: " << filename << std::endl;
-        exit(1);
+// "R G B"; anything after the third value (a GIMP color name) is ignored
+static bool parse_decimal_color(string_view line, std::array<uint8_t, 3>& rgb) {
+    const char* p = line.data();
+    const char* end = p + line.size();
+    for (int i = 0; i < 3; i++) {
+        while (p < end && (*p == ' ' || *p == '\t')) {
+            p++;
+        }
+        int value = 0;
+        auto [next, ec] = std::from_chars(p, end, value);
+        if (ec != std::errc() || value < 0 || value > 255) {
+            return false;
+        }
+        rgb[i] = value;
+        p = next;
     }
+    return true;
+}
 
-    std::string line;
-    bool beyond_first_line = false;
-    while (std::getline(file, line)) {
+bool PaletteParser::parseText(string_view text, Palette& out, string& error) {
+    enum class Format { Hex, Gimp, Jasc };
+    Format format = Format::Hex;
+    bool first_line = true;
+    int line_number = 0;
+
+    // JASC: a version line, then the color count
+    int jasc_header_lines = 0;
+    size_t jasc_count = 0;
+    int jasc_count_line = 0;
+
+    while (!text.empty()) {
+        size_t newline = text.find('\n');
+        string_view line = trim(text.substr(0, newline));
+        text.remove_prefix(
+            newline == string_view::npos ? text.size() : newline + 1
+        );
+        line_number++;
         if (line.empty()) {
             continue;
         }
-        if (beyond_first_line) {
-            palette_txt += ",\n";
+
+        if (first_line) {
+            first_line = false;
+            if (line.starts_with("GIMP Palette")) {
+                format = Format::Gimp;
+                continue;
+            }
+            if (line.starts_with("JASC-PAL")) {
+                format = Format::Jasc;
+                continue;
+            }
+        }
+
+        std::array<uint8_t, 3> rgb;
+        bool parsed = false;
+        const char* expected = "expected three values from 0 to 255";
+        switch (format) {
+            case Format::Hex:
+                if (line[0] == ';') {
+                    continue;
+                }
+                parsed = parse_hex_color(
+                    line.substr(0, line.find_first_of(" \t")),
+                    rgb
+                );
+                expected = "expected RRGGBB, #RRGGBB or AARRGGBB";
+                break;
+            case Format::Gimp:
+                if (line[0] == '#' || line.starts_with("Name:")
+                    || line.starts_with("Columns:")) {
+                    continue;
+                }
+                parsed = parse_decimal_color(line, rgb);
+                break;
+            case Format::Jasc:
+                if (jasc_header_lines == 0) {
+                    jasc_header_lines++;
+                    continue;
+                }
+                if (jasc_header_lines == 1) {
+                    jasc_header_lines++;
+                    jasc_count_line = line_number;
+                    auto [next, ec] = std::from_chars(
+                        line.data(),
+                        line.data() + line.size(),
+                        jasc_count
+                    );
+                    if (ec != std::errc()) {
+                        error = "line " + std::to_string(line_number)
+                            + ": expected the color count";
+                        return false;
+                    }
+                    continue;
+                }
+                parsed = parse_decimal_color(line, rgb);
+                break;
         }
-        vec3 color = hex_to_oklab(line);
-        palette_txt += "\tvec3(" + to_string(color.x) + ", "
-            + to_string(color.y) + ", " + to_string(color.z) + ")";
-        beyond_first_line = true;
+
+        if (!parsed) {
+            error = "line " + std::to_string(line_number) + ": " + expected
+                + ", got '" + string(line) + "'";
+            return false;
+        }
+        out.srgb.push_back(rgb);
+    }
+
+    if (format == Format::Jasc && out.size() != jasc_count) {
+        error = "line " + std::to_string(jasc_count_line) + ": header lists "
+            + std::to_string(jasc_count) + " colors, found "
+            + std::to_string(out.size());
+        return false;
+    }
+    return true;
+}
+
+bool PaletteParser::parsePng(const string& path, Palette& out, string& error) {
+    std::vector<unsigned char> pixels;
+    unsigned width, height;
+    unsigned lodepng_error = lodepng::decode(pixels, width, height, path);
+    if (lodepng_error) {
+        error = lodepng_error_text(lodepng_error);
+        return false;
     }
 
-    palette_txt += "\n);\n";
-    return palette_txt;
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+        if (pixels[i + 3] == 0) {
+            continue; // gaps between swatches
+        }
+        std::array<uint8_t, 3> rgb = {pixels[i], pixels[i + 1], pixels[i + 2]};
+        if (std::find(out.srgb.begin(), out.srgb.end(), rgb)
+            != out.srgb.end()) {
+            continue;
+        }
+        if (out.size() == MAX_PNG_COLORS) {
+            error = "more than " + std::to_string(MAX_PNG_COLORS)
+                + " colors, not a swatch strip";
+            return false;
+        }
+        out.srgb.push_back(rgb);
+    }
+    return true;
+}
+
+bool PaletteParser::load(
+    const string& path,
+    bool linear_rgb,
+    Palette& out,
+    string& error
+) {
+    out.clear();
+
+    bool parsed;
+    if (path.ends_with(".png") || path.ends_with(".PNG")) {
+        parsed = parsePng(path, out, error);
+    } else {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) {
+            error = path + ": failed to open";
+            return false;
+        }
+        buffer.resize(file.tellg());
+        file.seekg(0);
+        file.read(buffer.data(), buffer.size());
+        parsed = parseText(buffer, out, error);
+    }
+
+    if (parsed && out.size() == 0) {
+        parsed = false;
+        error = "no colors";
+    }
+    if (!parsed) {
+        error = path + ": " + error;
+        out.clear();
+        return false;
+    }
+
+    for (const std::array<uint8_t, 3>& c : out.srgb) {
+        Color3f rgb = linear_rgb
+            ? Color3f {
+                  linear_from_srgb8(c[0]),
+                  linear_from_srgb8(c[1]),
+                  linear_from_srgb8(c[2])
+              }
+            : Color3f {c[0] / 255.0f, c[1] / 255.0f, c[2] / 255.0f};
+        out.oklab.push_back(oklab_from_rgb(rgb));
+    }
+
+    out.by_lightness.resize(out.size());
+    std::iota(out.by_lightness.begin(), out.by_lightness.end(), 0);
+    std::stable_sort(
+        out.by_lightness.begin(),
+        out.by_lightness.end(),
+        [&](uint32_t a, uint32_t b) {
+            return out.oklab[a].x < out.oklab[b].x;
+        }
+    );
+    return true;
+}
+
+bool PaletteParser::generate_code_insert(
+    const string& path,
+    bool linear_rgb,
+    string& code,
+    string& error
+) {
+    PaletteParser parser;
+    Palette palette;
+    if (!parser.load(path, linear_rgb, palette, error)) {
+        return false;
+    }
+
+    code = "const vec3[] PALETTE = vec3[](\n";
+    char entry[96];
+    for (size_t i = 0; i < palette.size(); i++) {
+        Color3f c = palette.oklab[i];
+        const char* separator = i + 1 < palette.size() ? "," : "";
+        snprintf(
+            entry,
+            sizeof(entry),
+            "\tvec3(%f, %f, %f)%s\n",
+            c.x,
+            c.y,
+            c.z,
+            separator
+        );
+        code += entry;
+    }
+    code += ");\n";
+    return true;
 }
@@ -0,0 +1,243 @@
+#include "internal/palettescore.h"
+#include "internal/parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+
+// neighbours closer than this look continuous (roughly one JND in Oklab)
+const float SMOOTH_DELTA_E = 0.02f;
+// neighbours further apart than this are an edge worth keeping
+const float EDGE_DELTA_E = 0.1f;
+
+const double BANDING_WEIGHT = 1.0;
+const double EDGE_WEIGHT = 0.1;
+
+static float distance(Color3f a, Color3f b) {
+    float dx = a.x - b.x;
+    float dy = a.y - b.y;
+    float dz = a.z - b.z;
+    return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+ScoringReference::ScoringReference(
+    const unsigned char* rgba,
+    int width,
+    int height,
+    bool linear_rgb
+) :
+    width(width),
+    height(height) {
+    std::unordered_map<uint32_t, uint32_t> index_of;
+    std::vector<uint32_t> pixels(width * height);
+
+    for (int i = 0; i < width * height; i++) {
+        const unsigned char* p = rgba + i * 4;
+        uint32_t key = p[0] | (p[1] << 8) | (p[2] << 16);
+        auto [it, inserted] = index_of.try_emplace(key, colors.size());
+        if (inserted) {
+            Color3f rgb = linear_rgb
+                ? Color3f {
+                      linear_from_srgb8(p[0]),
+                      linear_from_srgb8(p[1]),
+                      linear_from_srgb8(p[2])
+                  }
+                : Color3f {p[0] / 255.0f, p[1] / 255.0f, p[2] / 255.0f};
+            colors.push_back(oklab_from_rgb_fast(rgb));
+            counts.push_back(0);
+        }
+        pixels[i] = it->second;
+        counts[it->second]++;
+    }
+
+    // right and upper neighbour of every pixel, merged by color pair
+    std::unordered_map<uint64_t, uint32_t> pair_of;
+    auto add_pair = [&](uint32_t a, uint32_t b) {
+        if (a == b) {
+            return;
+        }
+        if (a > b) {
+            std::swap(a, b);
+        }
+        float delta_e = distance(colors[a], colors[b]);
+        std::vector<Pair>* pairs = nullptr;
+        if (delta_e < SMOOTH_DELTA_E) {
+            pairs = &smooth_pairs;
+        } else if (delta_e > EDGE_DELTA_E) {
+            pairs = &edge_pairs;
+        } else {
+            return;
+        }
+        uint64_t key = ((uint64_t)a << 32) | b;
+        auto [it, inserted] = pair_of.try_emplace(key, pairs->size());
+        if (inserted) {
+            pairs->push_back({a, b, 0, delta_e});
+        }
+        (*pairs)[it->second].count++;
+    };
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint32_t here = pixels[y * width + x];
+            if (x + 1 < width) {
+                add_pair(here, pixels[y * width + x + 1]);
+            }
+            if (y + 1 < height) {
+                add_pair(here, pixels[(y + 1) * width + x]);
+            }
+        }
+    }
+}
+
+std::vector<std::string> list_palette_files(const std::string& dir) {
+    std::vector<std::string> paths;
+    std::error_code error;
+    for (const auto& entry :
+         std::filesystem::directory_iterator(dir, error)) {
+        std::string extension = entry.path().extension().string();
+        bool palette_extension = extension == ".hex" || extension == ".txt"
+            || extension == ".gpl" || extension == ".pal"
+            || extension == ".png";
+        if (entry.is_regular_file() && palette_extension) {
+            paths.push_back(entry.path().string());
+        }
+    }
+    if (error) {
+        std::cerr << "Failed to list palettes in " << dir << ": "
+                  << error.message() << std::endl;
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+// Nearest-color palettization (no dithering), measured on the reference's
+// unique colors and color pairs.
+static PaletteScore score_palette(
+    const ScoringReference& ref,
+    const std::vector<Color3f>& palette
+) {
+    PaletteScore score {};
+    if (palette.empty()) {
+        score.cost = INFINITY;
+        return score;
+    }
+
+    std::vector<uint32_t> nearest(ref.colors.size());
+    double error_sum = 0.0;
+    for (size_t u = 0; u < ref.colors.size(); u++) {
+        Color3f c = ref.colors[u];
+        float best = INFINITY;
+        for (size_t k = 0; k < palette.size(); k++) {
+            float dx = palette[k].x - c.x;
+            float dy = palette[k].y - c.y;
+            float dz = palette[k].z - c.z;
+            float d = dx * dx + dy * dy + dz * dz; // magnitude squared
+            if (d < best) {
+                best = d;
+                nearest[u] = k;
+            }
+        }
+        error_sum += sqrtf(best) * ref.counts[u];
+    }
+    score.mean_delta_e = error_sum / (ref.width * ref.height);
+
+    // steps above a JND where the reference was continuous
+    double banding_sum = 0.0;
+    double smooth_count = 0.0;
+    for (const ScoringReference::Pair& pair : ref.smooth_pairs) {
+        float step =
+            distance(palette[nearest[pair.a]], palette[nearest[pair.b]]);
+        banding_sum += std::max(0.0f, step - SMOOTH_DELTA_E) * pair.count;
+        smooth_count += pair.count;
+    }
+    score.banding = smooth_count > 0 ? banding_sum / smooth_count : 0.0;
+
+    double kept_sum = 0.0;
+    double edge_count = 0.0;
+    for (const ScoringReference::Pair& pair : ref.edge_pairs) {
+        float step =
+            distance(palette[nearest[pair.a]], palette[nearest[pair.b]]);
+        kept_sum += std::min(step, pair.delta_e) / pair.delta_e * pair.count;
+        edge_count += pair.count;
+    }
+    score.edge_preservation = edge_count > 0 ? kept_sum / edge_count : 1.0;
+
+    score.cost = score.mean_delta_e + BANDING_WEIGHT * score.banding
+        + EDGE_WEIGHT * (1.0 - score.edge_preservation);
+    return score;
+}
+
+std::vector<PaletteScore> score_palettes(
+    const ScoringReference& reference,
+    const std::vector<std::string>& palette_paths,
+    bool linear_rgb
+) {
+    auto start = std::chrono::steady_clock::now();
+
+    size_t count = palette_paths.size();
+    std::vector<PaletteScore> scores(count);
+    std::vector<std::string> errors(count);
+    // reused for every palette a thread loads
+    struct Loader {
+        PaletteParser parser;
+        Palette palette;
+    };
+    parallel_for<Loader>(count, [&](Loader& loader, size_t i) {
+        const std::string& path = palette_paths[i];
+        Palette& palette = loader.palette;
+        if (loader.parser.load(path, linear_rgb, palette, errors[i])) {
+            scores[i] = score_palette(reference, palette.oklab);
+        }
+        scores[i].path = path;
+    });
+    auto scored = std::chrono::steady_clock::now();
+
+    size_t loaded = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!errors[i].empty()) {
+            std::cerr << "Skipping " << errors[i] << std::endl;
+            continue;
+        }
+        // moving a string onto itself empties it
+        if (loaded != i) {
+            scores[loaded] = std::move(scores[i]);
+        }
+        loaded++;
+    }
+    scores.resize(loaded);
+
+    std::stable_sort(
+        scores.begin(),
+        scores.end(),
+        [](const PaletteScore& a, const PaletteScore& b) {
+            return a.cost < b.cost;
+        }
+    );
+
+    using ms = std::chrono::duration<double, std::milli>;
+    std::cout << "Loaded and scored " << loaded << "/" << count
+              << " palettes against a " << reference.width << "x"
+              << reference.height << " image (" << reference.colors.size()
+              << " unique colors) on " << parallel_thread_count(count)
+              << " threads in "
+              << ms(scored - start).count() << " ms" << std::endl;
+    return scores;
+}
+
+void print_palette_ranking(const std::vector<PaletteScore>& scores) {
+    std::cout << "rank   cost  mean dE  banding  edges  palette" << std::endl;
+    std::cout << std::fixed << std::setprecision(4);
+    for (size_t i = 0; i < scores.size(); i++) {
+        const PaletteScore& s = scores[i];
+        std::cout << std::setw(4) << i + 1 << " " << std::setw(7) << s.cost
+                  << " " << std::setw(8) << s.mean_delta_e << " "
+                  << std::setw(8) << s.banding << " " << std::setw(6)
+                  << s.edge_preservation << "  " << s.path << std::endl;
+    }
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::setprecision(6);
+}
@@ -1,26 +1,80 @@
 #include "internal/pixelartfx.h"
 #include "internal/scene.h"
+#include "internal/imagewrite.h"
+#include "internal/glstate.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+const char* BATCH_OUTPUT_PATH = "./palette_batch.png";
+// with --indexed-output; one file per palette
+const char* BATCH_TILE_PATH = "./palette_batch_%03d.png";
 
 PixelArtEffect::PixelArtEffect(
     GLFWwindow* window,
     int downscale_factor,
     cyGLSLProgram& outline_program,
     cyGLSLProgram& upscale_program,
-    Scene& scene
+    Scene& scene,
+    bool srgb
 ) :
     downscale_framebuffer_ID(0),
     downscale_texture_ID(5),
+    linear_depth_texture_ID(0),
     outline_framebuffer_ID(0),
     outline_texture_ID(7),
     rbo_ID(0),
     width(0),
     height(0),
+    base_width(0),
+    base_height(0),
+    capacity_width(0),
+    capacity_height(0),
     window(window),
     outline_program(outline_program),
     upscale_program(upscale_program),
     scene(scene),
-    downscale_factor(downscale_factor) {
+    timer_index(0),
+    timer_pending {false, false},
+    timer_total_ns(0),
+    timer_samples(0),
+    upscale_backend(UpscaleBackend::Blit),
+    srgb(srgb),
+    canvas_srgb(false),
+    batch_palette_texture_ID(0),
+    atlas_framebuffer_ID(0),
+    atlas_texture_ID(0),
+    atlas_index_texture_ID(0),
+    atlas_width(0),
+    atlas_height(0),
+    batch_query(0),
+    batch_requested(false),
+    output_width(0),
+    output_height(0),
+    downscale_factor(downscale_factor),
+    render_scale(downscale_factor),
+    indexed_output(false) {
     setupQuad();
+    glGenQueries(2, timer_queries);
+
+    if (srgb) {
+        GLint encoding = GL_LINEAR;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glGetFramebufferAttachmentParameteriv(
+            GL_FRAMEBUFFER,
+            GL_BACK_LEFT,
+            GL_FRAMEBUFFER_ATTACHMENT_COLOR_ENCODING,
+            &encoding
+        );
+        canvas_srgb = encoding == GL_SRGB;
+        upscale_program.SetUniform("EncodeSRGB", canvas_srgb ? 0 : 1);
+        std::cout << "sRGB render targets, "
+                  << (canvas_srgb ? "hardware" : "shader")
+                  << " encoding to the canvas" << std::endl;
+    }
 }
 
 PixelArtEffect::~PixelArtEffect() {
@@ -28,6 +82,8 @@ PixelArtEffect::~PixelArtEffect() {
         glDeleteFramebuffers(1, &downscale_framebuffer_ID);
     if (downscale_texture_ID)
         glDeleteTextures(1, &downscale_texture_ID);
+    if (linear_depth_texture_ID)
+        glDeleteTextures(1, &linear_depth_texture_ID);
     if (outline_framebuffer_ID)
         glDeleteFramebuffers(1, &outline_framebuffer_ID);
     if (outline_texture_ID)
@@ -36,6 +92,17 @@ PixelArtEffect::~PixelArtEffect() {
         glDeleteRenderbuffers(1, &rbo_ID);
     glDeleteVertexArrays(1, &quadVAO);
     glDeleteBuffers(1, &quadVBO);
+    glDeleteQueries(2, timer_queries);
+    if (batch_palette_texture_ID)
+        glDeleteTextures(1, &batch_palette_texture_ID);
+    if (atlas_framebuffer_ID)
+        glDeleteFramebuffers(1, &atlas_framebuffer_ID);
+    if (atlas_texture_ID)
+        glDeleteTextures(1, &atlas_texture_ID);
+    if (atlas_index_texture_ID)
+        glDeleteTextures(1, &atlas_index_texture_ID);
+    if (batch_query)
+        glDeleteQueries(1, &batch_query);
 }
 
 void PixelArtEffect::setupQuad() {
@@ -47,7 +114,7 @@ void PixelArtEffect::setupQuad() {
 
     glGenVertexArrays(1, &quadVAO);
     glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
+    gl_state().bindVertexArray(quadVAO);
     glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
     glBufferData(
         GL_ARRAY_BUFFER,
@@ -73,16 +140,17 @@ void PixelArtEffect::setupQuad() {
         5 * sizeof(float),
         (void*)(3 * sizeof(float))
     );
-    glBindVertexArray(0);
+    gl_state().bindVertexArray(0);
 }
 
 void PixelArtEffect::createFramebuffer(int w, int h) {
-    width = w;
-    height = h;
+    capacity_width = w;
+    capacity_height = h;
 
     if (downscale_framebuffer_ID) {
         glDeleteFramebuffers(1, &downscale_framebuffer_ID);
         glDeleteTextures(1, &downscale_texture_ID);
+        glDeleteTextures(1, &linear_depth_texture_ID);
         glDeleteRenderbuffers(1, &rbo_ID);
     }
     if (outline_framebuffer_ID) {
@@ -99,9 +167,9 @@ void PixelArtEffect::createFramebuffer(int w, int h) {
     glTexImage2D(
         GL_TEXTURE_2D,
         0,
-        GL_RGB,
-        width,
-        height,
+        colorFormat(),
+        capacity_width,
+        capacity_height,
         0,
         GL_RGB,
         GL_UNSIGNED_BYTE,
@@ -119,9 +187,43 @@ void PixelArtEffect::createFramebuffer(int w, int h) {
         0
     );
 
+    // linear depth written alongside the color, read by the outline pass
+    glGenTextures(1, &linear_depth_texture_ID);
+    glBindTexture(GL_TEXTURE_2D, linear_depth_texture_ID);
+    glTexImage2D(
+        GL_TEXTURE_2D,
+        0,
+        GL_R32F,
+        capacity_width,
+        capacity_height,
+        0,
+        GL_RED,
+        GL_FLOAT,
+        NULL
+    );
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glFramebufferTexture2D(
+        GL_FRAMEBUFFER,
+        GL_COLOR_ATTACHMENT1,
+        GL_TEXTURE_2D,
+        linear_depth_texture_ID,
+        0
+    );
+
+    GLenum draw_buffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, draw_buffers);
+
     glGenRenderbuffers(1, &rbo_ID);
     glBindRenderbuffer(GL_RENDERBUFFER, rbo_ID);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glRenderbufferStorage(
+        GL_RENDERBUFFER,
+        GL_DEPTH24_STENCIL8,
+        capacity_width,
+        capacity_height
+    );
     glFramebufferRenderbuffer(
         GL_FRAMEBUFFER,
         GL_DEPTH_STENCIL_ATTACHMENT,
@@ -138,9 +240,9 @@ void PixelArtEffect::createFramebuffer(int w, int h) {
     glTexImage2D(
         GL_TEXTURE_2D,
         0,
-        GL_RGB,
-        width,
-        height,
+        colorFormat(),
+        capacity_width,
+        capacity_height,
         0,
         GL_RGB,
         GL_UNSIGNED_BYTE,
@@ -159,50 +261,551 @@ void PixelArtEffect::createFramebuffer(int w, int h) {
     );
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // the old textures' names may come back for the new ones
+    gl_state().invalidate();
+
+    reportMemory();
+}
+
+GLenum PixelArtEffect::colorFormat() const {
+    return srgb ? GL_SRGB8_ALPHA8 : GL_RGB8;
+}
+
+void PixelArtEffect::setSRGBWrites(bool enabled) {
+    gl_state().setEnabled(GL_FRAMEBUFFER_SRGB, srgb && enabled);
+}
+
+size_t PixelArtEffect::memoryBytes() const {
+    int w = capacity_width;
+    int h = capacity_height;
+    return texture_bytes(colorFormat(), w, h) + texture_bytes(GL_R32F, w, h)
+        + texture_bytes(GL_DEPTH24_STENCIL8, w, h)
+        + texture_bytes(colorFormat(), w, h);
+}
+
+void PixelArtEffect::reportMemory() const {
+    int w = capacity_width;
+    int h = capacity_height;
+    std::cout << "Pixel art render targets " << w << "x" << h << ":"
+              << std::endl;
+    print_target_memory(
+        "downscale color",
+        texture_bytes(colorFormat(), w, h)
+    );
+    print_target_memory("linear depth", texture_bytes(GL_R32F, w, h));
+    print_target_memory(
+        "depth/stencil",
+        texture_bytes(GL_DEPTH24_STENCIL8, w, h)
+    );
+    print_target_memory("outline color", texture_bytes(colorFormat(), w, h));
+    print_target_memory("total", memoryBytes());
 }
 
 void PixelArtEffect::setFramebufferSize() {
     int fb_width, fb_height;
     glfwGetFramebufferSize(window, &fb_width, &fb_height);
 
-    int new_width = fb_width / downscale_factor;
-    int new_height = fb_height / downscale_factor;
+    // targets are sized for the full framebuffer (downscale_factor 1), so
+    // they only need to grow when the window does
+    bool grown = fb_width > capacity_width || fb_height > capacity_height;
+    if (grown) {
+        createFramebuffer(
+            std::max(fb_width, capacity_width),
+            std::max(fb_height, capacity_height)
+        );
+    }
+
+    base_width = std::max(1, fb_width / downscale_factor);
+    base_height = std::max(1, fb_height / downscale_factor);
+    int new_width = std::max(1, (int)(fb_width / render_scale));
+    int new_height = std::max(1, (int)(fb_height / render_scale));
+
+    // canvas area covered by the upscaled image; only a fractional
+    // render_scale makes texels land on uneven pixel counts
+    output_width = std::min(fb_width, (int)(new_width * render_scale + 0.5f));
+    output_height =
+        std::min(fb_height, (int)(new_height * render_scale + 0.5f));
 
-    if (new_width != width || new_height != height) {
-        createFramebuffer(new_width, new_height);
+    if (grown || new_width != width || new_height != height) {
+        width = new_width;
+        height = new_height;
+        updateUVScale();
     }
 }
 
+void PixelArtEffect::updateUVScale() {
+    float scale_x = (float)width / (float)capacity_width;
+    float scale_y = (float)height / (float)capacity_height;
+    outline_program.SetUniform("UVScale", scale_x, scale_y);
+    upscale_program.SetUniform("UVScale", scale_x, scale_y);
+}
+
 void PixelArtEffect::beginRender() {
     glBindFramebuffer(GL_FRAMEBUFFER, downscale_framebuffer_ID);
     glViewport(0, 0, width, height);
+    // mesh.frag's output is stored as-is, exactly as with plain RGB targets;
+    // with --srgb it is only decoded when the post-process samples it
+    setSRGBWrites(false);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // background sits at the far plane, where linear depth is 1
+    const GLfloat far_depth[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    glClearBufferfv(GL_COLOR, 1, far_depth);
 }
 
 void PixelArtEffect::endRender() {
+    glBeginQuery(GL_TIME_ELAPSED, timer_queries[timer_index]);
+
+    switch (upscale_backend) {
+        case UpscaleBackend::Blit:
+            drawOutline();
+            blitUpscale();
+            break;
+        case UpscaleBackend::Shader:
+            drawOutline();
+            drawUpscale();
+            break;
+        case UpscaleBackend::Fused:
+            // the fused pass never fills the outline target, so a
+            // recording needs the separate pass as well
+            if (recorder.isRecording()) {
+                drawOutline();
+            }
+            drawFused();
+            break;
+    }
+
+    setSRGBWrites(false);
+
+    glEndQuery(GL_TIME_ELAPSED);
+    collectTiming();
+
+    recorder.capture(outline_framebuffer_ID, width, height);
+
+    if (batch_requested) {
+        batch_requested = false;
+        renderPaletteBatch();
+    }
+}
+
+void PixelArtEffect::bindPostProcessInputs() {
+    outline_program.Bind();
+
+    gl_state().bindTexture(5, GL_TEXTURE_2D, downscale_texture_ID);
+    gl_state().bindTexture(6, GL_TEXTURE_2D, linear_depth_texture_ID);
+    gl_state().bindVertexArray(quadVAO);
+}
+
+void PixelArtEffect::drawOutline() {
     // OUTLINE POST-PROCESSING
     glBindFramebuffer(GL_FRAMEBUFFER, outline_framebuffer_ID);
+    glViewport(0, 0, width, height);
     glClear(GL_COLOR_BUFFER_BIT);
-    outline_program.Bind();
+    setSRGBWrites(true);
 
-    glActiveTexture(GL_TEXTURE5);
-    glBindTexture(GL_TEXTURE_2D, downscale_texture_ID);
+    bindPostProcessInputs();
+    outline_program.SetUniform("PixelScale", 1.0f);
+    outline_program.SetUniform("EncodeSRGB", 0);
 
-    glActiveTexture(GL_TEXTURE6);
-    glBindTexture(GL_TEXTURE_2D, scene.depth_texture.GetTextureID());
-
-    glBindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
 
+void PixelArtEffect::drawUpscale() {
     // UPSCALE TO FILL CANVAS
     upscale_program.Bind();
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    glViewport(0, 0, width * downscale_factor, height * downscale_factor);
+    glViewport(0, 0, output_width, output_height);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    setSRGBWrites(canvas_srgb);
 
-    glActiveTexture(GL_TEXTURE7);
-    glBindTexture(GL_TEXTURE_2D, outline_texture_ID);
+    gl_state().bindTexture(7, GL_TEXTURE_2D, outline_texture_ID);
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+void PixelArtEffect::blitUpscale() {
+    // UPSCALE TO FILL CANVAS, WITHOUT A SHADER
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, outline_framebuffer_ID);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+    glViewport(0, 0, output_width, output_height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // copy the already-encoded bytes without a decode/encode round trip
+    setSRGBWrites(false);
+    glBlitFramebuffer(
+        0,
+        0,
+        width,
+        height,
+        0,
+        0,
+        output_width,
+        output_height,
+        GL_COLOR_BUFFER_BIT,
+        GL_NEAREST
+    );
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void PixelArtEffect::drawFused() {
+    // OUTLINE + PALETTE, WRITTEN STRAIGHT TO THE CANVAS
+    // Every canvas pixel resolves the rendered texel it covers, so the
+    // intermediate outline texture and the upscale draw are skipped at the
+    // cost of repeating the palette search render_scale^2 times.
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, output_width, output_height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    setSRGBWrites(canvas_srgb);
+
+    bindPostProcessInputs();
+    outline_program.SetUniform("PixelScale", render_scale);
+    outline_program.SetUniform("EncodeSRGB", srgb && !canvas_srgb ? 1 : 0);
 
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 }
+
+void PixelArtEffect::collectTiming() {
+    timer_pending[timer_index] = true;
+    timer_index = (timer_index + 1) % 2;
+
+    // read last frame's query so the CPU never waits on the GPU
+    GLuint query = timer_queries[timer_index];
+    if (!timer_pending[timer_index]) {
+        return;
+    }
+    GLint available = 0;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        return;
+    }
+
+    GLuint64 elapsed_ns = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed_ns);
+    timer_pending[timer_index] = false;
+    timer_total_ns += elapsed_ns;
+    timer_samples++;
+
+    if (timer_samples == TIMER_REPORT_INTERVAL) {
+        double average_ms = timer_total_ns / (double)timer_samples / 1e6;
+        std::cout << "Post-process GPU time ("
+                  << upscale_backend_name(upscale_backend)
+                  << "): " << average_ms << " ms" << std::endl;
+        timer_total_ns = 0;
+        timer_samples = 0;
+    }
+}
+
+void PixelArtEffect::setUpscaleBackend(UpscaleBackend backend) {
+    upscale_backend = backend;
+    // don't average timings across backends
+    timer_total_ns = 0;
+    timer_samples = 0;
+}
+
+void PixelArtEffect::setBatchPalettes(const std::vector<Palette>& palettes) {
+    batch_palettes = palettes;
+    size_t max_size = 0;
+    for (const Palette& palette : palettes) {
+        max_size = std::max(max_size, palette.size());
+    }
+
+    // one row per palette, padded to the longest; PaletteSize bounds the
+    // search so padding is never matched
+    std::vector<Color3f> texels(max_size * palettes.size(), Color3f {0, 0, 0});
+    for (size_t i = 0; i < palettes.size(); i++) {
+        std::copy(
+            palettes[i].oklab.begin(),
+            palettes[i].oklab.end(),
+            texels.begin() + i * max_size
+        );
+    }
+
+    if (!batch_palette_texture_ID) {
+        glGenTextures(1, &batch_palette_texture_ID);
+        glGenQueries(1, &batch_query);
+    }
+    gl_state().bindTexture(GL_TEXTURE_1D_ARRAY, batch_palette_texture_ID);
+    glTexImage2D(
+        GL_TEXTURE_1D_ARRAY,
+        0,
+        GL_RGB32F,
+        max_size,
+        palettes.size(),
+        0,
+        GL_RGB,
+        GL_FLOAT,
+        texels.data()
+    );
+    glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    gl_state().bindTexture(GL_TEXTURE_1D_ARRAY, 0);
+}
+
+void PixelArtEffect::requestPaletteBatch() {
+    if (batch_palettes.empty()) {
+        std::cout << "No batch palettes loaded (see --palette-batch)"
+                  << std::endl;
+        return;
+    }
+    batch_requested = true;
+}
+
+std::vector<unsigned char> PixelArtEffect::readSceneColor() {
+    std::vector<unsigned char> pixels(width * height * 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, downscale_framebuffer_ID);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(
+        0,
+        0,
+        width,
+        height,
+        GL_RGBA,
+        GL_UNSIGNED_BYTE,
+        pixels.data()
+    );
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return pixels;
+}
+
+void PixelArtEffect::createAtlas(int w, int h) {
+    if (w == atlas_width && h == atlas_height) {
+        return;
+    }
+    atlas_width = w;
+    atlas_height = h;
+
+    if (atlas_framebuffer_ID) {
+        glDeleteFramebuffers(1, &atlas_framebuffer_ID);
+        glDeleteTextures(1, &atlas_texture_ID);
+        glDeleteTextures(1, &atlas_index_texture_ID);
+    }
+
+    glGenFramebuffers(1, &atlas_framebuffer_ID);
+    glBindFramebuffer(GL_FRAMEBUFFER, atlas_framebuffer_ID);
+
+    glGenTextures(1, &atlas_texture_ID);
+    glBindTexture(GL_TEXTURE_2D, atlas_texture_ID);
+    GLenum format = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    glTexImage2D(
+        GL_TEXTURE_2D,
+        0,
+        format,
+        atlas_width,
+        atlas_height,
+        0,
+        GL_RGBA,
+        GL_UNSIGNED_BYTE,
+        NULL
+    );
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glFramebufferTexture2D(
+        GL_FRAMEBUFFER,
+        GL_COLOR_ATTACHMENT0,
+        GL_TEXTURE_2D,
+        atlas_texture_ID,
+        0
+    );
+
+    // palette indices from pixelart.frag's second output
+    glGenTextures(1, &atlas_index_texture_ID);
+    glBindTexture(GL_TEXTURE_2D, atlas_index_texture_ID);
+    glTexImage2D(
+        GL_TEXTURE_2D,
+        0,
+        GL_R8UI,
+        atlas_width,
+        atlas_height,
+        0,
+        GL_RED_INTEGER,
+        GL_UNSIGNED_BYTE,
+        NULL
+    );
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glFramebufferTexture2D(
+        GL_FRAMEBUFFER,
+        GL_COLOR_ATTACHMENT1,
+        GL_TEXTURE_2D,
+        atlas_index_texture_ID,
+        0
+    );
+    gl_state().invalidate();
+
+    std::cout << "Palette batch atlas " << w << "x" << h << ":" << std::endl;
+    print_target_memory("atlas color", texture_bytes(format, w, h));
+    print_target_memory("atlas indices", texture_bytes(GL_R8UI, w, h));
+}
+
+void PixelArtEffect::renderPaletteBatch() {
+    // PALETTE PASS PER BATCH PALETTE, TILED INTO THE ATLAS
+    // The scene, shadow map and linear depth from this frame are reused;
+    // each extra palette only costs one low-res fullscreen pass.
+    int count = batch_palettes.size();
+    int columns = (int)std::ceil(std::sqrt((double)count));
+    int rows = (count + columns - 1) / columns;
+    createAtlas(columns * width, rows * height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, atlas_framebuffer_ID);
+    glViewport(0, 0, atlas_width, atlas_height);
+    setSRGBWrites(false);
+    // indexed captures only store the palette index
+    if (indexed_output) {
+        GLenum draw_buffers[] = {GL_NONE, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, draw_buffers);
+        const GLuint zero[] = {0, 0, 0, 0};
+        glClearBufferuiv(GL_COLOR, 1, zero);
+    } else {
+        GLenum draw_buffers[] = {GL_COLOR_ATTACHMENT0, GL_NONE};
+        glDrawBuffers(2, draw_buffers);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    setSRGBWrites(true);
+
+    bindPostProcessInputs();
+    gl_state().bindTexture(8, GL_TEXTURE_1D_ARRAY, batch_palette_texture_ID);
+    outline_program.SetUniform("PixelScale", 1.0f);
+    outline_program.SetUniform("EncodeSRGB", 0);
+
+    // the palettes are what's being compared, so match even if T is off
+    GLint toggle_palette = 1;
+    glGetUniformiv(
+        outline_program.GetID(),
+        glGetUniformLocation(outline_program.GetID(), "TogglePalette"),
+        &toggle_palette
+    );
+    outline_program.SetUniform("TogglePalette", 1);
+
+    glBeginQuery(GL_TIME_ELAPSED, batch_query);
+    for (int i = 0; i < count; i++) {
+        // first palette in the top left once the image is flipped below
+        int x = (i % columns) * width;
+        int y = (rows - 1 - i / columns) * height;
+        glViewport(x, y, width, height);
+        outline_program.SetUniform("TileOffset", (float)x, (float)y);
+        outline_program.SetUniform("PaletteLayer", i);
+        int palette_size = batch_palettes[i].size();
+        outline_program.SetUniform("PaletteSize", palette_size);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+
+    outline_program.SetUniform("TogglePalette", toggle_palette);
+    outline_program.SetUniform("PaletteLayer", -1);
+    outline_program.SetUniform("TileOffset", 0.0f, 0.0f);
+    setSRGBWrites(false);
+
+    // a one-off capture, so a synchronous read is fine here
+    auto save_start = std::chrono::steady_clock::now();
+    bool saved = indexed_output ? saveIndexedTiles(columns, rows) : saveAtlas();
+    std::chrono::duration<double, std::milli> save_time =
+        std::chrono::steady_clock::now() - save_start;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!saved) {
+        return;
+    }
+
+    GLuint64 elapsed_ns = 0;
+    glGetQueryObjectui64v(batch_query, GL_QUERY_RESULT, &elapsed_ns);
+    double elapsed_ms = elapsed_ns / 1e6;
+    std::cout << "Saved " << count << " palettes (" << columns << "x" << rows
+              << " tiles of " << width << "x" << height << ") to "
+              << (indexed_output ? BATCH_TILE_PATH : BATCH_OUTPUT_PATH)
+              << "; palette passes took " << elapsed_ms << " ms GPU, "
+              << elapsed_ms / count << " ms each; readback and encoding took "
+              << save_time.count() << " ms" << std::endl;
+}
+
+bool PixelArtEffect::saveAtlas() {
+    std::vector<unsigned char> pixels(atlas_width * atlas_height * 4);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(
+        0,
+        0,
+        atlas_width,
+        atlas_height,
+        GL_RGBA,
+        GL_UNSIGNED_BYTE,
+        pixels.data()
+    );
+
+    std::vector<unsigned char> flipped(pixels.size());
+    size_t row_bytes = atlas_width * 4;
+    for (int y = 0; y < atlas_height; y++) {
+        std::copy_n(
+            pixels.begin() + (atlas_height - 1 - y) * row_bytes,
+            row_bytes,
+            flipped.begin() + y * row_bytes
+        );
+    }
+
+    return write_rgba_png(
+        BATCH_OUTPUT_PATH,
+        flipped.data(),
+        atlas_width,
+        atlas_height
+    );
+}
+
+bool PixelArtEffect::saveIndexedTiles(int columns, int rows) {
+    std::vector<uint8_t> indices(atlas_width * atlas_height);
+    glReadBuffer(GL_COLOR_ATTACHMENT1);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(
+        0,
+        0,
+        atlas_width,
+        atlas_height,
+        GL_RED_INTEGER,
+        GL_UNSIGNED_BYTE,
+        indices.data()
+    );
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    // an indexed PNG has one palette, so every tile is its own file
+    std::vector<uint8_t> tile(width * height);
+    for (size_t i = 0; i < batch_palettes.size(); i++) {
+        int x = (i % columns) * width;
+        int y = (rows - 1 - i / columns) * height;
+        for (int row = 0; row < height; row++) {
+            int atlas_row = y + height - 1 - row;
+            std::copy_n(
+                indices.begin() + atlas_row * atlas_width + x,
+                width,
+                tile.begin() + row * width
+            );
+        }
+
+        char path[64];
+        snprintf(path, sizeof(path), BATCH_TILE_PATH, (int)i);
+        if (!write_indexed_png(
+                path,
+                tile.data(),
+                width,
+                height,
+                batch_palettes[i]
+            )) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const char* upscale_backend_name(UpscaleBackend backend) {
+    switch (backend) {
+        case UpscaleBackend::Blit:
+            return "blit";
+        case UpscaleBackend::Shader:
+            return "shader";
+        case UpscaleBackend::Fused:
+            return "fused";
+    }
+    return "unknown";
+}
@@ -1,8 +1,15 @@
 #include "internal/rendering.h"
+#include "internal/shadercache.h"
+#include "internal/glstate.h"
 
 #include "cy/cyTriMesh.h"
 #include "glad/glad.h"
 #include "lodepng.h"
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <map>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -16,151 +23,201 @@ ShaderPrograms build_programs() {
     cyGLSLProgram& pixelart_prog = programs.pixelart;
     cyGLSLProgram& upscale_prog = programs.upscale;
 
-    mesh_prog.BuildFiles("./shaders/mesh.vert", "./shaders/mesh.frag");
+    build_program_cached(
+        mesh_prog,
+        "./shaders/mesh.vert",
+        "./shaders/mesh.frag"
+    );
 
     mesh_prog.Bind();
     mesh_prog.RegisterUniform(0, "MVP");
     mesh_prog.RegisterUniform(1, "MVP");
-    mesh_prog.RegisterUniform(2, "BaseColor");
-    mesh_prog.RegisterUniform(3, "SpecularColor");
-    mesh_prog.RegisterUniform(4, "Shine");
+    mesh_prog.RegisterUniform(2, "Materials");
+    mesh_prog.RegisterUniform(3, "DiffuseTexture");
+    mesh_prog.RegisterUniform(4, "SpecularTexture");
     mesh_prog.RegisterUniform(5, "ShadowMap");
     mesh_prog.RegisterUniform(6, "LightSpaceMatrix");
     mesh_prog.RegisterUniform(7, "LightPosition");
     mesh_prog.RegisterUniform(8, "LightConeAngle");
+    mesh_prog.RegisterUniform(9, "NearPlane");
+    mesh_prog.RegisterUniform(10, "FarPlane");
+    mesh_prog.RegisterUniform(11, "Transforms");
 
     mesh_prog.SetUniform("ShadowMap", 4); // shadow map is texture unit 4
+    mesh_prog.SetUniform("DiffuseTexture", 0);
+    mesh_prog.SetUniform("SpecularTexture", 1);
+    mesh_prog.SetUniform("Transforms", 9); // scene transforms are unit 9
+    mesh_prog.SetUniform("Materials", 10); // scene materials are unit 10
 
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-    shadow_prog.BuildFiles("./shaders/shadow.vert", "./shaders/shadow.frag");
+    build_program_cached(
+        shadow_prog,
+        "./shaders/shadow.vert",
+        "./shaders/shadow.frag"
+    );
     shadow_prog.Bind();
     shadow_prog.RegisterUniform(0, "MVP");
+    shadow_prog.RegisterUniform(1, "Transforms");
+    shadow_prog.SetUniform("Transforms", 9);
 
-    pixelart_prog.BuildFiles(
+    build_program_cached(
+        pixelart_prog,
         "./shaders/pixelart.vert",
         "./shaders/pixelart-compiled.frag"
     );
     pixelart_prog.Bind();
     pixelart_prog.RegisterUniform(0, "ScreenTexture");
-    pixelart_prog.RegisterUniform(1, "DepthTexture");
+    pixelart_prog.RegisterUniform(1, "LinearDepthTexture");
     pixelart_prog.RegisterUniform(2, "TogglePalette");
     pixelart_prog.RegisterUniform(3, "Dither");
+    pixelart_prog.RegisterUniform(4, "UVScale");
+    pixelart_prog.RegisterUniform(5, "PixelScale");
+    pixelart_prog.RegisterUniform(6, "EncodeSRGB");
+    pixelart_prog.RegisterUniform(7, "PaletteTexture");
+    pixelart_prog.RegisterUniform(8, "PaletteLayer");
+    pixelart_prog.RegisterUniform(9, "PaletteSize");
+    pixelart_prog.RegisterUniform(10, "TileOffset");
 
     pixelart_prog.SetUniform("ScreenTexture", 5);
-    pixelart_prog.SetUniform("DepthTexture", 6);
+    pixelart_prog.SetUniform("LinearDepthTexture", 6);
     pixelart_prog.SetUniform("TogglePalette", 1);
     pixelart_prog.SetUniform("Dither", 0.0035f);
-
-    upscale_prog.BuildFiles("./shaders/upscale.vert", "./shaders/upscale.frag");
+    pixelart_prog.SetUniform("UVScale", 1.0f, 1.0f);
+    pixelart_prog.SetUniform("PixelScale", 1.0f);
+    pixelart_prog.SetUniform("EncodeSRGB", 0);
+    pixelart_prog.SetUniform("PaletteTexture", 8);
+    pixelart_prog.SetUniform("PaletteLayer", -1);
+    pixelart_prog.SetUniform("PaletteSize", 0);
+    pixelart_prog.SetUniform("TileOffset", 0.0f, 0.0f);
+
+    build_program_cached(
+        upscale_prog,
+        "./shaders/upscale.vert",
+        "./shaders/upscale.frag"
+    );
     upscale_prog.Bind();
     upscale_prog.RegisterUniform(0, "ScreenTexture");
+    upscale_prog.RegisterUniform(1, "UVScale");
+    upscale_prog.RegisterUniform(2, "EncodeSRGB");
     upscale_prog.SetUniform("ScreenTexture", 7);
+    upscale_prog.SetUniform("UVScale", 1.0f, 1.0f);
+    upscale_prog.SetUniform("EncodeSRGB", 0);
 
     return programs;
 }
 
-struct MeshData load_mesh(cyGLSLProgram& prog, char* path) {
-    prog.Bind();
+bool read_mesh_asset(const string& path, MeshAsset& out, string& error) {
     cyTriMesh mesh;
-    bool success = mesh.LoadFromFileObj(path);
-    if (!success) {
-        std::cout << "Failed to load obj file: '" << path << "'." << std::endl;
-        exit(-1);
+    std::ostringstream log;
+    if (!mesh.LoadFromFileObj(path.c_str(), true, &log)) {
+        error = "failed to load obj file: " + log.str();
+        return false;
     }
-
-    struct MeshData md = bind_mesh_vertex_attributes(prog, mesh);
-    if (mesh.NM() > 0) { // hecka jank
-        string diffuse_path = mesh.M(0).map_Kd.data;
-        string specular_path = mesh.M(0).map_Ks.data;
-        diffuse_path = "./assets/teapot/" + diffuse_path;
-        specular_path = "./assets/teapot/" + specular_path;
-        load_texture(prog, diffuse_path, (char*)"DiffuseTexture", 0);
-        load_texture(prog, specular_path, (char*)"SpecularTexture", 1);
+    mesh.ComputeNormals();
+    mesh.ComputeBoundingBox();
+    bool has_texcoords = mesh.NVT() > 0;
+
+    // corners with the same position, normal and texture coordinate share
+    // a vertex, which the simplifier needs to see the surface as connected
+    std::map<std::array<unsigned int, 3>, unsigned int> vertex_of;
+    std::vector<unsigned int> indices;
+    out.vertices.clear();
+    out.vertices.reserve(mesh.NV() * 8);
+    indices.reserve(mesh.NF() * 3);
+    for (unsigned int i = 0; i < mesh.NF(); i++) {
+        for (int j = 0; j < 3; j++) {
+            unsigned int vIndex = mesh.F(i).v[j];
+            unsigned int nIndex = mesh.FN(i).v[j];
+            unsigned int tIndex = has_texcoords ? mesh.FT(i).v[j] : 0;
+            auto [it, inserted] = vertex_of.try_emplace(
+                {vIndex, nIndex, tIndex},
+                out.vertices.size() / 8
+            );
+            indices.push_back(it->second);
+            if (!inserted) {
+                continue;
+            }
+
+            out.vertices.push_back(mesh.V(vIndex).x);
+            out.vertices.push_back(mesh.V(vIndex).y);
+            out.vertices.push_back(mesh.V(vIndex).z);
+
+            out.vertices.push_back(mesh.VN(nIndex).x);
+            out.vertices.push_back(mesh.VN(nIndex).y);
+            out.vertices.push_back(mesh.VN(nIndex).z);
+
+            cyVec3f uv(0, 0, 0);
+            if (has_texcoords) {
+                uv = mesh.VT(tIndex);
+            }
+            out.vertices.push_back(uv.x);
+            out.vertices.push_back(uv.y);
+        }
     }
 
-    return md;
-}
-
-void read_texture_and_handle_error(
-    vector<unsigned char>& img_data_out,
-    unsigned& width_out,
-    unsigned& height_out,
-    const char* img_path
-) {
-    unsigned error =
-        lodepng::decode(img_data_out, width_out, height_out, img_path);
-    if (error) {
-        std::cout << "Error loading texture: " << lodepng_error_text(error)
-                  << std::endl;
-        exit(-1);
+    out.indices.clear();
+    out.lods.clear();
+    for (LODIndices& lod : load_lods(path, out.vertices, 8, indices)) {
+        out.lods.push_back({
+            (unsigned int)out.indices.size(),
+            (unsigned int)lod.indices.size(),
+            lod.error
+        });
+        out.indices.insert(
+            out.indices.end(),
+            lod.indices.begin(),
+            lod.indices.end()
+        );
+    }
+    out.bound_min = mesh.GetBoundMin();
+    out.bound_max = mesh.GetBoundMax();
+
+    out.diffuse_map.clear();
+    out.specular_map.clear();
+    if (mesh.NM() > 0) {
+        const cyTriMesh::Mtl& mtl = mesh.M(0);
+        out.material.diffuse = cyVec3f(mtl.Kd[0], mtl.Kd[1], mtl.Kd[2]);
+        out.material.specular = cyVec3f(mtl.Ks[0], mtl.Ks[1], mtl.Ks[2]);
+        out.material.ambient = cyVec3f(mtl.Ka[0], mtl.Ka[1], mtl.Ka[2]);
+        out.material.shine = mtl.Ns;
+
+        // MTL texture paths are relative to the OBJ
+        std::filesystem::path dir = std::filesystem::path(path).parent_path();
+        if (mtl.map_Kd.data && mtl.map_Kd.data[0]) {
+            out.diffuse_map = (dir / mtl.map_Kd.data).lexically_normal();
+        }
+        if (mtl.map_Ks.data && mtl.map_Ks.data[0]) {
+            out.specular_map = (dir / mtl.map_Ks.data).lexically_normal();
+        }
+    } else {
+        out.material.diffuse = cyVec3f(0.15, 0.15, 0.45);
+        out.material.specular = cyVec3f(0.65, 0.65, 0.65);
+        out.material.ambient = cyVec3f(0.21, 0.21, 0.21);
+        out.material.shine = 90.0;
     }
+    out.material.diffuse_texture = 0;
+    out.material.specular_texture = 0;
+    return true;
 }
 
-void load_texture(
-    cyGLSLProgram& prog,
-    string filepath,
-    char* attrib_name,
-    unsigned tex_id
-) {
-    prog.Bind();
-    unsigned width, height;
-    vector<unsigned char> diffuse_data;
-
-    read_texture_and_handle_error(
-        diffuse_data,
-        width,
-        height,
-        (char*)filepath.c_str()
-    );
-
+GLuint
+upload_texture(const unsigned char* rgba, unsigned width, unsigned height) {
     cyGLTexture2D texture;
-
-    glActiveTexture(GL_TEXTURE0 + tex_id);
-
     texture.Initialize();
-    texture.SetImage(diffuse_data.data(), 4, width, height);
+    texture.SetImage(rgba, 4, width, height);
     texture.BuildMipmaps();
     texture.SetFilteringMode(GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR);
-    texture.SetWrappingMode(GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T);
-    texture.Bind(tex_id);
-
-    prog[attrib_name] = tex_id;
+    texture.SetWrappingMode(GL_REPEAT, GL_REPEAT);
+    return texture.GetID();
 }
 
-struct MeshData
-bind_mesh_vertex_attributes(cyGLSLProgram& prog, cyTriMesh& mesh) {
+struct MeshData upload_mesh_asset(cyGLSLProgram& prog, const MeshAsset& asset) {
     prog.Bind();
-    mesh.ComputeNormals();
-
-    // do some pre-processing
-    vector<float> vertexData;
-    vector<unsigned int> indices;
-
-    for (unsigned int i = 0; i < mesh.NF(); i++) {
-        for (int j = 0; j < 3; j++) {
-            unsigned int vIndex = mesh.F(i).v[j];
-            unsigned int tIndex = mesh.FT(i).v[j];
-            unsigned int nIndex = mesh.FN(i).v[j];
-
-            vertexData.push_back(mesh.V(vIndex).x);
-            vertexData.push_back(mesh.V(vIndex).y);
-            vertexData.push_back(mesh.V(vIndex).z);
-
-            vertexData.push_back(mesh.VN(nIndex).x);
-            vertexData.push_back(mesh.VN(nIndex).y);
-            vertexData.push_back(mesh.VN(nIndex).z);
-
-            vertexData.push_back(mesh.VT(tIndex).x);
-            vertexData.push_back(mesh.VT(tIndex).y);
-
-            indices.push_back(i * 3 + j);
-        }
-    }
 
     GLuint VAO;
     glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    gl_state().bindVertexArray(VAO);
 
     GLuint VBO, EBO;
     glGenBuffers(1, &VBO);
@@ -169,16 +226,16 @@ bind_mesh_vertex_attributes(cyGLSLProgram& prog, cyTriMesh& mesh) {
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(
         GL_ARRAY_BUFFER,
-        vertexData.size() * sizeof(float),
-        vertexData.data(),
+        asset.vertices.size() * sizeof(float),
+        asset.vertices.data(),
         GL_STATIC_DRAW
     );
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(
         GL_ELEMENT_ARRAY_BUFFER,
-        indices.size() * sizeof(unsigned int),
-        indices.data(),
+        asset.indices.size() * sizeof(unsigned int),
+        asset.indices.data(),
         GL_STATIC_DRAW
     );
 
@@ -218,7 +275,72 @@ bind_mesh_vertex_attributes(cyGLSLProgram& prog, cyTriMesh& mesh) {
     );
     glEnableVertexAttribArray(txc_attrib);
 
-    glBindVertexArray(0);
+    // the shadow pass only reads positions; fetching them from a 12-byte
+    // stream instead of the 32-byte interleaved one cuts its vertex reads
+    // to under half
+    std::vector<float> positions;
+    positions.reserve(asset.vertices.size() / 8 * 3);
+    for (size_t i = 0; i < asset.vertices.size(); i += 8) {
+        positions.insert(
+            positions.end(),
+            asset.vertices.begin() + i,
+            asset.vertices.begin() + i + 3
+        );
+    }
+    GLuint depth_VAO, position_VBO;
+    glGenVertexArrays(1, &depth_VAO);
+    gl_state().bindVertexArray(depth_VAO);
+    glGenBuffers(1, &position_VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, position_VBO);
+    glBufferData(
+        GL_ARRAY_BUFFER,
+        positions.size() * sizeof(float),
+        positions.data(),
+        GL_STATIC_DRAW
+    );
+    glVertexAttribPointer(pos_attrib, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(pos_attrib);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+    gl_state().bindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    MeshData data {};
+    data.VAO = VAO;
+    data.VBO = VBO;
+    data.EBO = EBO;
+    data.depth_VAO = depth_VAO;
+    data.position_VBO = position_VBO;
+    data.lod_count = asset.lods.size();
+    std::copy(asset.lods.begin(), asset.lods.end(), data.lods);
+    data.bound_min = asset.bound_min;
+    data.bound_max = asset.bound_max;
+    return data;
+}
+
+// Estimated size of a render target. Drivers pad 24-bit formats to 32 bits.
+size_t texture_bytes(GLenum internal_format, int width, int height) {
+    size_t bytes_per_texel;
+    switch (internal_format) {
+        case GL_R8UI:
+            bytes_per_texel = 1;
+            break;
+        case GL_DEPTH_COMPONENT16:
+            bytes_per_texel = 2;
+            break;
+        case GL_RGB:
+        case GL_RGB8:
+        case GL_DEPTH_COMPONENT24:
+        case GL_DEPTH24_STENCIL8:
+        case GL_R32F:
+        default:
+            bytes_per_texel = 4;
+            break;
+    }
+    return bytes_per_texel * width * height;
+}
 
-    return {VAO, VBO, EBO, mesh.NF(), mesh};
+void print_target_memory(const char* name, size_t bytes) {
+    std::cout << "  " << name << ": " << bytes / (1024.0 * 1024.0) << " MB"
+              << std::endl;
 }
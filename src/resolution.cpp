@@ -0,0 +1,105 @@
+#include "internal/resolution.h"
+
+#include <algorithm>
+#include <iostream>
+
+ResolutionController::ResolutionController(double target_frame_ms) :
+    enabled(false),
+    target_frame_ms(target_frame_ms),
+    query_pending {false, false},
+    query_index(0),
+    scale(0),
+    average_frame_ms(0),
+    frames_since_change(0) {
+    glGenQueries(4, &timestamp_queries[0][0]);
+}
+
+ResolutionController::~ResolutionController() {
+    glDeleteQueries(4, &timestamp_queries[0][0]);
+}
+
+void ResolutionController::beginFrame() {
+    glQueryCounter(timestamp_queries[query_index][0], GL_TIMESTAMP);
+}
+
+void ResolutionController::endFrame() {
+    glQueryCounter(timestamp_queries[query_index][1], GL_TIMESTAMP);
+    query_pending[query_index] = true;
+    query_index = (query_index + 1) % 2;
+
+    double frame_ms;
+    if (enabled && scale != 0 && readFrameTime(frame_ms)) {
+        average_frame_ms += (frame_ms - average_frame_ms) * SMOOTHING;
+    }
+}
+
+void ResolutionController::applyScale(PixelArtEffect& pixel_effect) {
+    float min_scale = pixel_effect.downscale_factor;
+    float max_scale = min_scale * MAX_SCALE_RATIO;
+
+    if (!enabled) {
+        scale = 0;
+        pixel_effect.render_scale = min_scale;
+        return;
+    }
+
+    // start from the user's setting, and follow it when it changes
+    if (scale == 0) {
+        scale = min_scale;
+        average_frame_ms = target_frame_ms;
+        frames_since_change = 0;
+    }
+    scale = std::clamp(scale, min_scale, max_scale);
+
+    frames_since_change++;
+    if (frames_since_change >= SETTLE_FRAMES) {
+        float new_scale = scale;
+        if (average_frame_ms > target_frame_ms * OVER_BUDGET) {
+            new_scale = std::min(scale + SCALE_STEP, max_scale);
+        } else if (average_frame_ms < target_frame_ms * UNDER_BUDGET) {
+            new_scale = std::max(scale - SCALE_STEP, min_scale);
+        }
+
+        if (new_scale != scale) {
+            scale = new_scale;
+            frames_since_change = 0;
+            std::cout << "Dynamic resolution: scale " << scale << " ("
+                      << average_frame_ms << " ms / " << target_frame_ms
+                      << " ms)" << std::endl;
+        }
+    }
+
+    pixel_effect.render_scale = scale;
+}
+
+bool ResolutionController::readFrameTime(double& frame_ms) {
+    if (!query_pending[query_index]) {
+        return false;
+    }
+
+    GLint available = 0;
+    glGetQueryObjectiv(
+        timestamp_queries[query_index][1],
+        GL_QUERY_RESULT_AVAILABLE,
+        &available
+    );
+    if (!available) {
+        return false;
+    }
+
+    GLuint64 begin_ns, end_ns;
+    glGetQueryObjectui64v(
+        timestamp_queries[query_index][0],
+        GL_QUERY_RESULT,
+        &begin_ns
+    );
+    glGetQueryObjectui64v(
+        timestamp_queries[query_index][1],
+        GL_QUERY_RESULT,
+        &end_ns
+    );
+    query_pending[query_index] = false;
+
+    frame_ms = (end_ns - begin_ns) / 1e6;
+    return true;
+}
@@ -1,91 +1,480 @@
 #include "internal/spotlight.h"
 #include "internal/rendering.h"
 #include "internal/scene.h"
+#include "internal/scenefile.h"
+#include "internal/parallel.h"
+#include "internal/glstate.h"
+#include "internal/ui.h"
+#include "lodepng.h"
 #include <OpenGL/gl.h>
 
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <unordered_map>
 
-Scene::Scene(ShaderPrograms& programs, GLFWwindow* window) :
+// shadow texels per rendered pixel along each axis when auto-sizing
+const unsigned int SHADOW_TEXELS_PER_PIXEL = 4;
+const unsigned int MIN_SHADOW_SIZE = 256;
+const unsigned int MAX_SHADOW_SIZE = 4096;
+// draw submission time is averaged over this many frames, like latency
+const int SUBMIT_REPORT_FRAMES = 120;
+// how far a simplified mesh may stray from the full one on screen, in
+// pixels of the downscaled target, and in shadow map texels (which PCF
+// softens, and which are already finer than the target's pixels)
+const float LOD_ERROR_PIXELS = 0.5f;
+const float SHADOW_LOD_ERROR_TEXELS = 2.0f;
+
+static double ms_since(std::chrono::steady_clock::time_point start) {
+    using ms = std::chrono::duration<double, std::milli>;
+    return ms(std::chrono::steady_clock::now() - start).count();
+}
+
+Scene::Scene(
+    ShaderPrograms& programs,
+    GLFWwindow* window,
+    const string& scene_path
+) :
     light(
         cyVec3f(0.0, -50.0, 40.0),
         cyVec3f(0.0, 0.0, 0.0),
         50.0,
         programs.shadow,
         programs.mesh,
-        4096,
-        4096
+        MIN_SHADOW_SIZE,
+        MIN_SHADOW_SIZE,
+        GL_DEPTH_COMPONENT24
     ),
-    programs(programs) {
+    light_fixed(false),
+    programs(programs),
+    fixed_shadow_size(0),
+    shadow_depth_format(GL_DEPTH_COMPONENT24),
+    use_lods(true),
+    shadow_culled(0),
+    color_culled(0),
+    material_buffer(0),
+    material_texture(0),
+    render_height(0),
+    submit_ms(0),
+    shadow_triangles(0),
+    color_triangles(0),
+    submit_frames(0) {
     programs.mesh.Bind();
+    view_projection.SetIdentity();
+    load(scene_path);
+    // the light's shadow map and the textures were set up through cy
+    gl_state().invalidate();
+}
 
-    Mesh duck(load_mesh(programs.mesh, (char*)"./assets/duck/duck.obj"), true);
+Scene::~Scene() {
+    std::cout << "Cleaning up scene" << std::endl;
+    for (MeshData& buffer : buffers) {
+        glDeleteBuffers(1, &buffer.VBO);
+        glDeleteBuffers(1, &buffer.EBO);
+        glDeleteBuffers(1, &buffer.position_VBO);
+        glDeleteVertexArrays(1, &buffer.VAO);
+        glDeleteVertexArrays(1, &buffer.depth_VAO);
+    }
+    glDeleteTextures(textures.size(), textures.data());
+    glDeleteTextures(1, &material_texture);
+    glDeleteBuffers(1, &material_buffer);
+}
 
-    Mesh teapot(
-        load_mesh(programs.mesh, (char*)"./assets/teapot/teapot.obj"),
-        true
-    );
+// Index of key in unique, appending it the first time it's seen.
+static size_t
+unique_index(std::unordered_map<string, size_t>& index_of, const string& key) {
+    return index_of.try_emplace(key, index_of.size()).first->second;
+}
 
-    Mesh plane(
-        load_mesh(programs.mesh, (char*)"./assets/ground/hb1.obj"),
-        true
-    );
+// A mesh's row of the material table: four RGBA32F texels, unpacked by
+// fetch_material in mesh.vert.
+static void material_texels(const Mesh& mesh, float texels[16]) {
+    const MaterialData& material = mesh.material;
+    const GoochTones& gooch = mesh.gooch;
+    float row[16] = {
+        material.diffuse.x,
+        material.diffuse.y,
+        material.diffuse.z,
+        material.shine,
+        material.specular.x,
+        material.specular.y,
+        material.specular.z,
+        gooch.alpha,
+        gooch.cool_oklab.x,
+        gooch.cool_oklab.y,
+        gooch.cool_oklab.z,
+        gooch.beta,
+        gooch.warm_oklab.x,
+        gooch.warm_oklab.y,
+        gooch.warm_oklab.z,
+        0.0f
+    };
+    std::copy(row, row + 16, texels);
+}
 
-    meshes.push_back(duck);
-    meshes.push_back(teapot);
-    meshes.push_back(plane);
+void Scene::load(const string& path) {
+    SceneFile file;
+    string error;
+    if (!file.load(path, error)) {
+        std::cerr << "Failed to load scene " << error << std::endl;
+        exit(1);
+    }
+    auto start = std::chrono::steady_clock::now();
 
-    int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
+    place_camera(file);
+    if (file.light_position) {
+        light.origin = *file.light_position;
+        light_fixed = true;
+    }
+    if (file.light_target) {
+        light.lookat = *file.light_target;
+    }
+    if (file.light_fov) {
+        light.fov = *file.light_fov;
+    }
+    light.updateMVP();
+    light.updateUniforms();
 
-    depth_texture.Initialize(
-        false, // depth comparison texture
-        2048, // width
-        2048 // height
-    );
+    // each OBJ is read once however many meshes place it
+    std::unordered_map<string, size_t> obj_index;
+    vector<size_t> obj_of_mesh;
+    for (const SceneMesh& mesh : file.meshes) {
+        obj_of_mesh.push_back(unique_index(obj_index, mesh.obj_path));
+    }
+    vector<string> obj_paths(obj_index.size());
+    for (const auto& [obj_path, i] : obj_index) {
+        obj_paths[i] = obj_path;
+    }
 
-    depth_texture.SetTextureFilteringMode(GL_LINEAR, GL_LINEAR);
+    vector<MeshAsset> assets(obj_paths.size());
+    vector<string> errors(obj_paths.size());
+    parallel_for(obj_paths.size(), [&](size_t i) {
+        read_mesh_asset(obj_paths[i], assets[i], errors[i]);
+    });
+    for (size_t i = 0; i < obj_paths.size(); i++) {
+        if (!errors[i].empty()) {
+            std::cerr << "Failed to load scene " << path << ": "
+                      << obj_paths[i] << ": " << errors[i] << std::endl;
+            exit(1);
+        }
+    }
+
+    // textures are only read if a placed mesh ends up using them, and
+    // once however many materials share them
+    std::unordered_map<string, size_t> texture_index;
+    vector<MaterialData> materials;
+    vector<GoochTones> tones;
+    vector<size_t> diffuse_of_mesh, specular_of_mesh;
+    for (size_t m = 0; m < file.meshes.size(); m++) {
+        const MeshAsset& asset = assets[obj_of_mesh[m]];
+        MaterialData material = asset.material;
+        string diffuse_map = asset.diffuse_map;
+        string specular_map = asset.specular_map;
+        cyVec3f cool = GOOCH_COOL;
+        cyVec3f warm = GOOCH_WARM;
+        float alpha = GOOCH_ALPHA;
+        float beta = GOOCH_BETA;
+        if (!file.meshes[m].material.empty()) {
+            const SceneMaterial& o = file.materials[file.meshes[m].material];
+            material.diffuse = o.diffuse.value_or(material.diffuse);
+            material.specular = o.specular.value_or(material.specular);
+            material.shine = o.shine.value_or(material.shine);
+            diffuse_map = o.diffuse_map.value_or(diffuse_map);
+            specular_map = o.specular_map.value_or(specular_map);
+            cool = o.cool.value_or(cool);
+            warm = o.warm.value_or(warm);
+            alpha = o.alpha.value_or(alpha);
+            beta = o.beta.value_or(beta);
+        }
+        materials.push_back(material);
+        tones.emplace_back(cool, warm, alpha, beta);
+        // no map samples a white texel, leaving the material color as is
+        diffuse_of_mesh.push_back(unique_index(texture_index, diffuse_map));
+        specular_of_mesh.push_back(unique_index(texture_index, specular_map));
+    }
+
+    struct Image {
+        vector<unsigned char> rgba;
+        unsigned width, height;
+    };
+    vector<string> texture_paths(texture_index.size());
+    for (const auto& [texture_path, i] : texture_index) {
+        texture_paths[i] = texture_path;
+    }
+    vector<Image> images(texture_paths.size());
+    errors.assign(texture_paths.size(), "");
+    parallel_for(texture_paths.size(), [&](size_t i) {
+        Image& image = images[i];
+        if (texture_paths[i].empty()) {
+            image = {{255, 255, 255, 255}, 1, 1};
+            return;
+        }
+        unsigned lodepng_error = lodepng::decode(
+            image.rgba,
+            image.width,
+            image.height,
+            texture_paths[i]
+        );
+        if (lodepng_error) {
+            errors[i] = lodepng_error_text(lodepng_error);
+        }
+    });
+    for (size_t i = 0; i < texture_paths.size(); i++) {
+        if (!errors[i].empty()) {
+            std::cerr << "Failed to load scene " << path
+                      << ": error loading texture " << texture_paths[i]
+                      << ": " << errors[i] << std::endl;
+            exit(1);
+        }
+    }
+    auto read = std::chrono::steady_clock::now();
+
+    // GL calls stay on this thread; each buffer and texture is uploaded once
+    for (const Image& image : images) {
+        textures.push_back(
+            upload_texture(image.rgba.data(), image.width, image.height)
+        );
+    }
+    for (MeshAsset& asset : assets) {
+        buffers.push_back(upload_mesh_asset(programs.mesh, asset));
+    }
 
-    depth_texture.Bind();
+    // parents are listed before their children, which TransformArray
+    // relies on
+    for (size_t m = 0; m < file.meshes.size(); m++) {
+        const SceneMesh& placement = file.meshes[m];
+        int node = transforms.add(
+            placement.parent,
+            placement.position,
+            placement.rotation,
+            placement.scale
+        );
+        if (placement.spin != 0) {
+            spins.push_back({node, placement.rotation, placement.spin});
+        }
+        materials[m].diffuse_texture = textures[diffuse_of_mesh[m]];
+        materials[m].specular_texture = textures[specular_of_mesh[m]];
+        meshes.emplace_back(
+            buffers[obj_of_mesh[m]],
+            materials[m],
+            node,
+            (int)m,
+            placement.casts_shadow,
+            tones[m]
+        );
+    }
+    animate(0);
+
+    // per-mesh material values, fetched by the vertex shader so that
+    // packed draws need no uniforms between meshes
+    vector<float> table(meshes.size() * 16);
+    for (const Mesh& mesh : meshes) {
+        material_texels(mesh, &table[mesh.material_index * 16]);
+    }
+    glGenBuffers(1, &material_buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, material_buffer);
+    glBufferData(
+        GL_TEXTURE_BUFFER,
+        table.size() * sizeof(float),
+        table.data(),
+        GL_DYNAMIC_DRAW // rows change through updateMaterial
+    );
+    glGenTextures(1, &material_texture);
+    gl_state().bindTexture(GL_TEXTURE_BUFFER, material_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, material_buffer);
+    gl_state().bindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    auto uploaded = std::chrono::steady_clock::now();
+
+    using ms = std::chrono::duration<double, std::milli>;
+    std::cout << "Loaded " << path << ": " << meshes.size() << " meshes from "
+              << buffers.size() << " OBJ files and " << textures.size()
+              << " textures in " << ms(uploaded - start).count() << " ms ("
+              << ms(read - start).count() << " ms reading)" << std::endl;
+    for (size_t i = 0; i < obj_paths.size(); i++) {
+        std::cout << "  " << obj_paths[i] << ":";
+        const MeshData& data = buffers[i];
+        for (int lod = 0; lod < data.lod_count; lod++) {
+            std::cout << (lod ? " / " : " ")
+                      << data.lods[lod].index_count / 3;
+        }
+        std::cout << " triangles per level of detail" << std::endl;
+    }
 }
 
-Scene::~Scene() {
-    std::cout << "Cleaning up scene" << std::endl;
+void Scene::animate(double seconds) {
+    for (const Spin& spin : spins) {
+        cyVec3f rotation = spin.rotation;
+        rotation.z += fmod(spin.speed * seconds, 2 * M_PI);
+        transforms.setRotation(spin.node, rotation);
+    }
+
+    if (transforms.update() == 0) {
+        return;
+    }
     for (Mesh& mesh : meshes) {
-        mesh.cleanup();
+        if (transforms.moved(mesh.transform)) {
+            mesh.updateBounds(transforms.world(mesh.transform));
+        }
+    }
+    transforms.upload();
+}
+
+void Scene::enablePackedDraws() {
+    packed = std::make_unique<PackedMeshes>(meshes);
+    std::cout << "Packed " << meshes.size() << " meshes into shared buffers ("
+              << packed->memoryBytes() / (1024.0 * 1024.0) << " MB)"
+              << std::endl;
+}
+
+void Scene::updateMaterial(int mesh) {
+    float texels[16];
+    material_texels(meshes[mesh], texels);
+    glBindBuffer(GL_TEXTURE_BUFFER, material_buffer);
+    glBufferSubData(
+        GL_TEXTURE_BUFFER,
+        meshes[mesh].material_index * sizeof(texels),
+        sizeof(texels),
+        texels
+    );
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void Scene::fitShadowMap(int base_width, int base_height, int render_height) {
+    unsigned int size = fixed_shadow_size;
+    if (size == 0) {
+        unsigned int pixels = std::max(base_width, base_height);
+        size = std::bit_ceil(pixels * SHADOW_TEXELS_PER_PIXEL);
+        size = std::clamp(size, MIN_SHADOW_SIZE, MAX_SHADOW_SIZE);
     }
+    light.resize(size, size, shadow_depth_format);
+    this->render_height = render_height;
+}
+
+unsigned int Scene::chooseLOD(
+    int i,
+    const cyMatrix4f& view_projection,
+    float height,
+    float max_error
+) {
+    const Mesh& mesh = meshes[i];
+    lods[i] = use_lods ? mesh.selectLOD(view_projection, height, max_error)
+                       : 0;
+    return mesh.mesh_data.lods[lods[i]].index_count / 3;
 }
 
 void Scene::drawShadowMap() {
+    cyMatrix4f light_view_projection = light.getViewProjection();
+    Frustum light_frustum(light_view_projection);
+    unsigned int culled = 0;
+    unsigned int triangles = 0;
+
     programs.shadow.Bind();
+    gl_state().bindTexture(9, GL_TEXTURE_BUFFER, transforms.getTextureID());
     light.Bind();
-    for (Mesh& mesh : meshes) {
-        if (mesh.casts_shadow) {
-            mesh.draw();
+
+    auto start = std::chrono::steady_clock::now();
+    visible.clear();
+    lods.resize(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++) {
+        Mesh& mesh = meshes[i];
+        if (!mesh.casts_shadow) {
+            continue;
+        }
+        if (!light_frustum.intersectsBox(mesh.bound_min, mesh.bound_max)) {
+            culled++;
+            continue;
+        }
+        triangles += chooseLOD(
+            i,
+            light_view_projection,
+            light.height,
+            SHADOW_LOD_ERROR_TEXELS
+        );
+        if (packed) {
+            visible.push_back(i);
+        } else {
+            mesh.bindDraw();
+            mesh.drawDepth(lods[i]);
         }
     }
+    if (packed) {
+        packed->draw(visible, lods, false);
+    }
+    submit_ms += ms_since(start);
+    shadow_triangles += triangles;
     light.Unbind();
+
+    reportCulling("shadow", shadow_culled, culled);
 }
 
 void Scene::drawMeshes() {
     programs.mesh.Bind();
-    glActiveTexture(GL_TEXTURE4); // shadow map
-    glBindTexture(GL_TEXTURE_2D, light.getTextureID());
+    gl_state().bindTexture(4, GL_TEXTURE_2D, light.getTextureID()); // shadow
+    gl_state().bindTexture(9, GL_TEXTURE_BUFFER, transforms.getTextureID());
+    gl_state().bindTexture(10, GL_TEXTURE_BUFFER, material_texture);
 
-    glActiveTexture(GL_TEXTURE6); // depth map
-    glBindTexture(GL_TEXTURE_2D, depth_texture.GetTextureID());
+    // shading and linear depth (for outlines) are written in a single pass
+    Frustum camera_frustum(view_projection);
+    unsigned int culled = 0;
+    unsigned int triangles = 0;
+    auto start = std::chrono::steady_clock::now();
+    visible.clear();
+    lods.resize(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++) {
+        Mesh& mesh = meshes[i];
+        if (!camera_frustum.intersectsBox(mesh.bound_min, mesh.bound_max)) {
+            culled++;
+            continue;
+        }
+        triangles +=
+            chooseLOD(i, view_projection, render_height, LOD_ERROR_PIXELS);
+        if (packed) {
+            visible.push_back(i);
+        } else {
+            mesh.bindDraw();
+            mesh.bindTextures();
+            mesh.draw(lods[i]);
+        }
+    }
+    if (packed) {
+        packed->draw(visible, lods, true);
+    }
+    color_triangles += triangles;
+    reportSubmitTime(ms_since(start));
 
-    // first render to depth texture
-    depth_texture.Bind();
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    for (Mesh& mesh : meshes) {
-        mesh.bindMaterialProperties(programs.mesh);
-        mesh.draw();
+    reportCulling("color", color_culled, culled);
+}
+
+void Scene::reportSubmitTime(double color_pass_ms) {
+    submit_ms += color_pass_ms;
+    if (++submit_frames < SUBMIT_REPORT_FRAMES) {
+        return;
     }
-    depth_texture.Unbind();
+    std::cout << "Draw submission (" << (packed ? "packed" : "per mesh")
+              << "): " << submit_ms / submit_frames
+              << " ms CPU per frame for " << meshes.size() << " meshes"
+              << std::endl;
+    std::cout << "Triangles per frame: " << shadow_triangles / submit_frames
+              << " in shadow pass, " << color_triangles / submit_frames
+              << " in color pass" << (use_lods ? "" : " (full detail)")
+              << std::endl;
+    submit_ms = 0;
+    shadow_triangles = 0;
+    color_triangles = 0;
+    submit_frames = 0;
+}
 
-    // then render normal shading
-    for (Mesh& mesh : meshes) {
-        mesh.bindMaterialProperties(programs.mesh);
-        mesh.draw();
+void Scene::reportCulling(
+    const char* pass,
+    unsigned int& count,
+    unsigned int n
+) {
+    if (n != count) {
+        std::cout << "Culled " << n << "/" << meshes.size() << " meshes in "
+                  << pass << " pass" << std::endl;
     }
+    count = n;
 }
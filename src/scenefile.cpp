@@ -0,0 +1,270 @@
+#include "internal/scenefile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+// Reads the values after a keyword; on failure, error names the keyword.
+class StatementReader {
+  public:
+    StatementReader(const string& line, string& error) :
+        words(line),
+        error(error) {}
+
+    bool next(string& word) {
+        return (bool)(words >> word);
+    }
+
+    bool number(const string& keyword, float& value) {
+        if (!(words >> value) || !std::isfinite(value)) {
+            error = "expected a number after '" + keyword + "'";
+            return false;
+        }
+        return true;
+    }
+
+    bool vector(const string& keyword, cyVec3f& value) {
+        if (!(words >> value.x >> value.y >> value.z)) {
+            error = "expected three numbers after '" + keyword + "'";
+            return false;
+        }
+        return true;
+    }
+
+    bool word(const string& keyword, string& value) {
+        if (!(words >> value)) {
+            error = "expected a value after '" + keyword + "'";
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    std::istringstream words;
+    string& error;
+};
+
+static float radians(float degrees) {
+    return degrees * (float)M_PI / 180.0f;
+}
+
+static bool parse_camera(StatementReader& in, SceneFile& scene, string& error) {
+    string key;
+    float value;
+    while (in.next(key)) {
+        if (!in.number(key, value)) {
+            return false;
+        }
+        if (key == "distance") {
+            scene.camera_distance = value;
+        } else if (key == "orbit") {
+            scene.camera_orbit = radians(value);
+        } else if (key == "tilt") {
+            scene.camera_tilt = radians(value);
+        } else {
+            error = "unknown camera setting '" + key + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parse_light(StatementReader& in, SceneFile& scene, string& error) {
+    string key;
+    while (in.next(key)) {
+        cyVec3f v;
+        float value;
+        if (key == "position") {
+            if (!in.vector(key, v)) {
+                return false;
+            }
+            scene.light_position = v;
+        } else if (key == "target") {
+            if (!in.vector(key, v)) {
+                return false;
+            }
+            scene.light_target = v;
+        } else if (key == "fov") {
+            if (!in.number(key, value)) {
+                return false;
+            }
+            scene.light_fov = value;
+        } else {
+            error = "unknown light setting '" + key + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parse_material(
+    StatementReader& in,
+    const fs::path& dir,
+    SceneMaterial& material,
+    string& error
+) {
+    string key;
+    while (in.next(key)) {
+        cyVec3f v;
+        float value;
+        string path;
+        bool ok;
+        if (key == "diffuse") {
+            ok = in.vector(key, v);
+            material.diffuse = v;
+        } else if (key == "specular") {
+            ok = in.vector(key, v);
+            material.specular = v;
+        } else if (key == "shine") {
+            ok = in.number(key, value);
+            material.shine = value;
+        } else if (key == "diffuse_map") {
+            ok = in.word(key, path);
+            material.diffuse_map = (dir / path).lexically_normal().string();
+        } else if (key == "specular_map") {
+            ok = in.word(key, path);
+            material.specular_map = (dir / path).lexically_normal().string();
+        } else if (key == "cool") {
+            ok = in.vector(key, v);
+            material.cool = v;
+        } else if (key == "warm") {
+            ok = in.vector(key, v);
+            material.warm = v;
+        } else if (key == "alpha") {
+            ok = in.number(key, value);
+            material.alpha = value;
+        } else if (key == "beta") {
+            ok = in.number(key, value);
+            material.beta = value;
+        } else {
+            error = "unknown material setting '" + key + "'";
+            return false;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parse_mesh(
+    StatementReader& in,
+    const SceneFile& scene,
+    SceneMesh& mesh,
+    string& error
+) {
+    string key;
+    while (in.next(key)) {
+        string value;
+        bool ok;
+        if (key == "material") {
+            ok = in.word(key, value);
+            if (ok && !scene.materials.contains(value)) {
+                error = "material '" + value + "' is not defined above";
+                return false;
+            }
+            mesh.material = value;
+        } else if (key == "name") {
+            ok = in.word(key, mesh.name);
+        } else if (key == "parent") {
+            ok = in.word(key, value);
+            auto named = [&](const SceneMesh& m) { return m.name == value; };
+            auto found = std::find_if(
+                scene.meshes.begin(),
+                scene.meshes.end(),
+                named
+            );
+            if (ok && found == scene.meshes.end()) {
+                error = "parent '" + value + "' is not named above";
+                return false;
+            }
+            mesh.parent = found - scene.meshes.begin();
+        } else if (key == "spin") {
+            ok = in.number(key, mesh.spin);
+            mesh.spin *= (float)M_PI / 180.0f;
+        } else if (key == "position") {
+            ok = in.vector(key, mesh.position);
+        } else if (key == "rotation") {
+            ok = in.vector(key, mesh.rotation);
+            mesh.rotation *= (float)M_PI / 180.0f;
+        } else if (key == "scale") {
+            ok = in.number(key, mesh.scale);
+        } else if (key == "shadow") {
+            ok = in.word(key, value);
+            if (ok && value != "on" && value != "off") {
+                error = "expected 'on' or 'off' after 'shadow'";
+                return false;
+            }
+            mesh.casts_shadow = value == "on";
+        } else {
+            error = "unknown mesh setting '" + key + "'";
+            return false;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SceneFile::load(const string& path, string& error) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        error = path + ": failed to open";
+        return false;
+    }
+    fs::path dir = fs::path(path).parent_path();
+    error.clear();
+
+    string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+        line = line.substr(0, line.find('#'));
+
+        StatementReader in(line, error);
+        string statement;
+        if (!in.next(statement)) {
+            continue; // blank or comment
+        }
+
+        bool parsed;
+        if (statement == "camera") {
+            parsed = parse_camera(in, *this, error);
+        } else if (statement == "light") {
+            parsed = parse_light(in, *this, error);
+        } else if (statement == "material") {
+            string name;
+            parsed = in.word(statement, name)
+                && parse_material(in, dir, materials[name], error);
+        } else if (statement == "mesh") {
+            string obj;
+            SceneMesh mesh;
+            parsed = in.word(statement, obj)
+                && parse_mesh(in, *this, mesh, error);
+            if (parsed) {
+                mesh.obj_path = (dir / obj).lexically_normal().string();
+                meshes.push_back(mesh);
+            }
+        } else {
+            parsed = false;
+            error = "unknown statement '" + statement + "'";
+        }
+
+        if (!parsed) {
+            error = path + ": line " + std::to_string(line_number) + ": "
+                + error;
+            return false;
+        }
+    }
+
+    if (meshes.empty()) {
+        error = path + ": no meshes";
+        return false;
+    }
+    return true;
+}
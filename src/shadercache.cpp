@@ -0,0 +1,157 @@
+#include "internal/shadercache.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+const char* SHADER_CACHE_DIR = "./shader_cache";
+
+static bool read_file(const char* path, string& contents) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+// FNV-1a, so keys are stable between runs and builds
+static uint64_t hash_string(const string& s, uint64_t hash) {
+    for (unsigned char c : s) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static string cache_path(
+    const char* fragment_path,
+    const string& vertex_source,
+    const string& fragment_source
+) {
+    uint64_t hash = 14695981039346656037ull;
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+        hash = hash_string((const char*)glGetString(name), hash);
+    }
+    hash = hash_string(vertex_source, hash);
+    hash = hash_string(fragment_source, hash);
+
+    std::ostringstream path;
+    path << SHADER_CACHE_DIR << "/"
+         << std::filesystem::path(fragment_path).stem().string() << "-"
+         << std::hex << hash << ".bin";
+    return path.str();
+}
+
+static bool load_binary(cyGLSLProgram& prog, const string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    GLenum format;
+    if (!file.read((char*)&format, sizeof(format))) {
+        return false;
+    }
+    vector<char> binary(
+        (std::istreambuf_iterator<char>(file)),
+        std::istreambuf_iterator<char>()
+    );
+    if (binary.empty()) {
+        return false;
+    }
+
+    prog.CreateProgram();
+    glProgramBinary(prog.GetID(), format, binary.data(), binary.size());
+
+    // drivers reject binaries from other versions; fall back to compiling
+    GLint linked = GL_FALSE;
+    glGetProgramiv(prog.GetID(), GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+static void save_binary(cyGLSLProgram& prog, const string& path) {
+    GLint length = 0;
+    glGetProgramiv(prog.GetID(), GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    GLenum format;
+    vector<char> binary(length);
+    glGetProgramBinary(prog.GetID(), length, NULL, &format, binary.data());
+
+    std::error_code error;
+    std::filesystem::create_directories(SHADER_CACHE_DIR, error);
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write shader cache: " << path << std::endl;
+        return;
+    }
+    file.write((const char*)&format, sizeof(format));
+    file.write(binary.data(), binary.size());
+}
+
+bool build_program_cached(
+    cyGLSLProgram& prog,
+    const char* vertex_path,
+    const char* fragment_path
+) {
+    string vertex_source, fragment_source;
+    if (!read_file(vertex_path, vertex_source)
+        || !read_file(fragment_path, fragment_source)) {
+        std::cerr << "Failed to read shaders: " << vertex_path << ", "
+                  << fragment_path << std::endl;
+        return false;
+    }
+
+    // some drivers (notably macOS) expose no binary formats at all
+    GLint num_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+    bool cacheable = num_formats > 0;
+
+    string path;
+    if (cacheable) {
+        path = cache_path(fragment_path, vertex_source, fragment_source);
+        if (load_binary(prog, path)) {
+            return true;
+        }
+    }
+
+    cyGLSLShader vertex_shader, fragment_shader;
+    if (!vertex_shader.Compile(vertex_source.c_str(), GL_VERTEX_SHADER)
+        || !fragment_shader.Compile(
+            fragment_source.c_str(),
+            GL_FRAGMENT_SHADER
+        )) {
+        return false;
+    }
+
+    prog.CreateProgram();
+    prog.AttachShader(vertex_shader);
+    prog.AttachShader(fragment_shader);
+    if (cacheable) {
+        glProgramParameteri(
+            prog.GetID(),
+            GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+            GL_TRUE
+        );
+    }
+    if (!prog.Link()) {
+        return false;
+    }
+
+    if (cacheable) {
+        save_binary(prog, path);
+    }
+    return true;
+}
@@ -9,6 +9,9 @@
 #include <cy/cyVector.h>
 
 #include "internal/spotlight.h"
+#include "internal/glstate.h"
+
+#include <iostream>
 
 SpotLight::SpotLight(
     cyVec3f origin,
@@ -17,29 +20,25 @@ SpotLight::SpotLight(
     cyGLSLProgram& shadow_program,
     cyGLSLProgram& mesh_program,
     unsigned int width,
-    unsigned int height
+    unsigned int height,
+    GLenum depth_format
 ) :
     origin(origin),
     lookat(lookat),
     fov(fov),
     width(width),
     height(height),
+    depth_format(depth_format),
     shadow_program(shadow_program),
     mesh_program(mesh_program) {
-    // Build shader
-    this->shadow_program.BuildFiles(
-        "./shaders/shadow.vert",
-        "./shaders/shadow.frag"
-    );
-    this->shadow_program.Bind();
-    this->shadow_program.RegisterUniform(0, "MVP");
+    // shadow_program is built by build_programs
     updateMVP();
 
     glBindTexture(GL_TEXTURE_2D, this->depth_map);
     glGenTextures(1, &this->depth_map);
 
     this->shadow_map
-        .Initialize(true, this->width, this->height, GL_DEPTH_COMPONENT24);
+        .Initialize(true, this->width, this->height, this->depth_format);
 
     this->shadow_map.SetTextureFilteringMode(GL_LINEAR, GL_LINEAR);
     this->shadow_map.Bind();
@@ -47,6 +46,27 @@ SpotLight::SpotLight(
     glBindFramebuffer(GL_FRAMEBUFFER, 0); // Unbind framebuffer
 }
 
+void SpotLight::resize(uint width, uint height, GLenum depth_format) {
+    if (width == this->width && height == this->height
+        && depth_format == this->depth_format) {
+        return;
+    }
+    this->width = width;
+    this->height = height;
+    this->depth_format = depth_format;
+    this->shadow_map.Resize(this->width, this->height, this->depth_format);
+    gl_state().invalidate(); // cy rebinds the depth texture itself
+    updateMVP();
+
+    std::cout << "Shadow map " << this->width << "x" << this->height << ":"
+              << std::endl;
+    print_target_memory("depth", memoryBytes());
+}
+
+size_t SpotLight::memoryBytes() const {
+    return texture_bytes(this->depth_format, this->width, this->height);
+}
+
 void SpotLight::updateMVP() {
     this->projection = cyMatrix4f::Perspective(
         this->fov * 3.145 / 180.0, // deg to rad
@@ -67,12 +87,14 @@ void SpotLight::Bind() {
     this->shadow_map.Bind();
     glViewport(0, 0, this->width, this->height);
     glClear(GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_DEPTH_TEST);
-    glCullFace(GL_FRONT);
+    gl_state().setEnabled(GL_DEPTH_TEST, true);
+    gl_state().cullFace(GL_FRONT);
 }
 
 void SpotLight::Unbind() {
     this->shadow_map.Unbind();
+    // the color pass expects the default again
+    gl_state().cullFace(GL_BACK);
 }
 
 GLuint SpotLight::getTextureID() {
@@ -87,6 +109,10 @@ cyMatrix4f SpotLight::getLightSpaceMatrix() const {
     return result;
 }
 
+cyMatrix4f SpotLight::getViewProjection() const {
+    return this->projection;
+}
+
 void SpotLight::updateUniforms() {
     this->mesh_program.Bind();
     float lightSpaceMatrix[16];
@@ -0,0 +1,147 @@
+#include "internal/transforms.h"
+#include "internal/glstate.h"
+
+#include <algorithm>
+#include <cmath>
+
+// matrices are uploaded as they are stored, column-major
+static_assert(sizeof(cyMatrix4f) == 16 * sizeof(float));
+
+// Translation * RotationZ * RotationY * RotationX * Scale, written out
+// directly instead of as four matrix products.
+static cyMatrix4f compose(cyVec3f position, cyVec3f rotation, float scale) {
+    float cx = cosf(rotation.x), sx = sinf(rotation.x);
+    float cy = cosf(rotation.y), sy = sinf(rotation.y);
+    float cz = cosf(rotation.z), sz = sinf(rotation.z);
+
+    cyMatrix4f m;
+    float* c = m.cell; // column-major
+    c[0] = cz * cy * scale;
+    c[1] = sz * cy * scale;
+    c[2] = -sy * scale;
+    c[3] = 0;
+    c[4] = (cz * sy * sx - sz * cx) * scale;
+    c[5] = (sz * sy * sx + cz * cx) * scale;
+    c[6] = cy * sx * scale;
+    c[7] = 0;
+    c[8] = (cz * sy * cx + sz * sx) * scale;
+    c[9] = (sz * sy * cx - cz * sx) * scale;
+    c[10] = cy * cx * scale;
+    c[11] = 0;
+    c[12] = position.x;
+    c[13] = position.y;
+    c[14] = position.z;
+    c[15] = 1;
+    return m;
+}
+
+TransformArray::TransformArray() :
+    upload_begin(0),
+    upload_end(0),
+    buffer(0),
+    texture(0),
+    capacity(0) {}
+
+TransformArray::~TransformArray() {
+    glDeleteTextures(1, &texture);
+    glDeleteBuffers(1, &buffer);
+}
+
+int TransformArray::add(
+    int parent,
+    cyVec3f position,
+    cyVec3f rotation,
+    float scale
+) {
+    parents.push_back(parent);
+    positions.push_back(position);
+    rotations.push_back(rotation);
+    scales.push_back(scale);
+    worlds.emplace_back();
+    dirty.push_back(1);
+    changed.push_back(0);
+    return parents.size() - 1;
+}
+
+void TransformArray::setPosition(int node, cyVec3f position) {
+    positions[node] = position;
+    dirty[node] = 1;
+}
+
+void TransformArray::setRotation(int node, cyVec3f rotation) {
+    rotations[node] = rotation;
+    dirty[node] = 1;
+}
+
+void TransformArray::setScale(int node, float scale) {
+    scales[node] = scale;
+    dirty[node] = 1;
+}
+
+int TransformArray::update() {
+    int updated = 0;
+    size_t first = size();
+    size_t last = 0;
+    for (size_t i = 0; i < size(); i++) {
+        int parent = parents[i];
+        // parents come first, so changed[parent] is already this frame's
+        changed[i] = dirty[i] || (parent != NO_PARENT && changed[parent]);
+        if (!changed[i]) {
+            continue;
+        }
+        dirty[i] = 0;
+
+        cyMatrix4f local = compose(positions[i], rotations[i], scales[i]);
+        worlds[i] = parent == NO_PARENT ? local : worlds[parent] * local;
+
+        first = std::min(first, i);
+        last = i;
+        updated++;
+    }
+
+    if (updated > 0) {
+        if (upload_begin == upload_end) {
+            upload_begin = first;
+            upload_end = last + 1;
+        } else {
+            upload_begin = std::min(upload_begin, first);
+            upload_end = std::max(upload_end, last + 1);
+        }
+    }
+    return updated;
+}
+
+void TransformArray::upload() {
+    if (!texture) {
+        glGenBuffers(1, &buffer);
+        glGenTextures(1, &texture);
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    if (capacity < size()) {
+        // reallocating loses the contents, so everything goes up again
+        capacity = std::max(size(), capacity * 2);
+        glBufferData(
+            GL_TEXTURE_BUFFER,
+            capacity * sizeof(cyMatrix4f),
+            NULL,
+            GL_DYNAMIC_DRAW
+        );
+        gl_state().bindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+        gl_state().bindTexture(GL_TEXTURE_BUFFER, 0);
+        upload_begin = 0;
+        upload_end = size();
+    }
+    if (upload_begin < upload_end) {
+        glBufferSubData(
+            GL_TEXTURE_BUFFER,
+            upload_begin * sizeof(cyMatrix4f),
+            (upload_end - upload_begin) * sizeof(cyMatrix4f),
+            worlds.data() + upload_begin
+        );
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    upload_begin = 0;
+    upload_end = 0;
+}
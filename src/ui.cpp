@@ -2,6 +2,9 @@
 #include "glad/glad.h"
 #include "internal/rendering.h"
 #include "internal/ui.h"
+#include "internal/glstate.h"
+
+#include <algorithm>
 
 static double lastMouseX;
 static double lastMouseY;
@@ -13,6 +16,10 @@ static float camDist = 400;
 static bool plusKeyDebounce = true;
 static bool minusKeyDebounce = true;
 static bool tKeyDebounce = true;
+static bool fKeyDebounce = true;
+static bool rKeyDebounce = true;
+static bool bKeyDebounce = true;
+static bool cKeyDebounce = true;
 static bool togglePalette = true;
 
 static float dither = 0.0035f;
@@ -24,18 +31,25 @@ const double KEY_REPEAT_INTERVAL = 0.25;
 const float CAM_MIN_DIST = 200;
 const float CAM_MAX_DIST = 1200;
 
+const float CAM_NEAR = 1.0f;
+const float CAM_FAR = 5000.0f;
+
 float deg2rad(float deg) {
     return deg * 3.145 / 180.0;
 }
 
-GLFWwindow* initAndCreateWindow() {
+GLFWwindow* initAndCreateWindow(bool srgb) {
     if (!glfwInit())
         return nullptr;
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_SAMPLES, 8); // MSAA 8x
+    // No MSAA on the default framebuffer: it only ever receives the
+    // upscaled image, and glBlitFramebuffer can't target a multisampled one.
+    glfwWindowHint(GLFW_SAMPLES, 0);
+    // lets the shader upscale and fused backends encode in the ROP
+    glfwWindowHint(GLFW_SRGB_CAPABLE, srgb ? GLFW_TRUE : GLFW_FALSE);
 
     GLFWwindow* window =
         glfwCreateWindow(960, 720, "Palette Matcher", NULL, NULL);
@@ -56,15 +70,19 @@ GLFWwindow* initAndCreateWindow() {
         exit(-1);
     }
 
-    glEnable(GL_DEPTH_TEST);
+    gl_state().setEnabled(GL_DEPTH_TEST, true);
     glDepthFunc(GL_LESS);
-    glEnable(GL_MULTISAMPLE);
+    gl_state().setEnabled(GL_MULTISAMPLE, true);
 
     glClearColor(64.0 / 255.0, 6.0 / 255.0, 191.0 / 255.0, 1.0f);
     return window;
 }
 
-void process_input(GLFWwindow* window, PixelArtEffect& pixel_art_effect) {
+void process_input(
+    GLFWwindow* window,
+    PixelArtEffect& pixel_art_effect,
+    ResolutionController& resolution
+) {
     // ESCAPE TO CLOSE WINDOW
 
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
@@ -138,6 +156,79 @@ void process_input(GLFWwindow* window, PixelArtEffect& pixel_art_effect) {
         tKeyDebounce = true;
     }
 
+    // F TO CYCLE UPSCALE BACKENDS (BLIT -> SHADER -> FUSED)
+
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) {
+        if (fKeyDebounce) {
+            UpscaleBackend next;
+            switch (pixel_art_effect.GetUpscaleBackend()) {
+                case UpscaleBackend::Blit:
+                    next = UpscaleBackend::Shader;
+                    break;
+                case UpscaleBackend::Shader:
+                    next = UpscaleBackend::Fused;
+                    break;
+                default:
+                    next = UpscaleBackend::Blit;
+                    break;
+            }
+            pixel_art_effect.setUpscaleBackend(next);
+            std::cout << "Upscale backend: " << upscale_backend_name(next)
+                      << std::endl;
+            fKeyDebounce = false;
+        }
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_RELEASE) {
+        fKeyDebounce = true;
+    }
+
+    // R TO TOGGLE DYNAMIC RESOLUTION
+
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) {
+        if (rKeyDebounce) {
+            resolution.enabled = !resolution.enabled;
+            std::cout << "Dynamic resolution: "
+                      << (resolution.enabled ? "on" : "off") << std::endl;
+            rKeyDebounce = false;
+        }
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_RELEASE) {
+        rKeyDebounce = true;
+    }
+
+    // B TO CAPTURE THE VIEW UNDER EVERY BATCH PALETTE
+
+    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS) {
+        if (bKeyDebounce) {
+            pixel_art_effect.requestPaletteBatch();
+            bKeyDebounce = false;
+        }
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE) {
+        bKeyDebounce = true;
+    }
+
+    // C TO START/STOP RECORDING FRAMES
+
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
+        if (cKeyDebounce) {
+            FrameRecorder& recorder = pixel_art_effect.recorder;
+            if (recorder.isRecording()) {
+                recorder.stop();
+            } else {
+                recorder.start();
+            }
+            cKeyDebounce = false;
+        }
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE) {
+        cKeyDebounce = true;
+    }
+
     // COMMA/PERIOD TO INCREASE/DECREASE DITHER AMOUNT
 
     if (glfwGetKey(window, GLFW_KEY_COMMA) == GLFW_PRESS) {
@@ -181,18 +272,29 @@ void cursor_position_callback(GLFWwindow* window, double xPos, double yPos) {
     lastMouseY = yPos;
 }
 
+void orbit_camera(float radians) {
+    camRotX += radians;
+}
+
+void place_camera(const SceneFile& scene) {
+    camDist = scene.camera_distance.value_or(camDist);
+    camDist = std::clamp(camDist, CAM_MIN_DIST, CAM_MAX_DIST);
+    camRotX = scene.camera_orbit.value_or(camRotX);
+    camRotY = scene.camera_tilt.value_or(camRotY);
+}
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
 }
 
-void update_camera(GLFWwindow* window, ShaderPrograms& programs) {
+cyMatrix4f update_camera(GLFWwindow* window, ShaderPrograms& programs) {
     int width, height;
     glfwGetFramebufferSize(window, &width, &height);
     cyMatrix4f projection = cy::Matrix4f::Perspective(
         deg2rad(5.0),
         (float)width / (float)height,
-        1.0f,
-        5000.0f
+        CAM_NEAR,
+        CAM_FAR
     );
 
     cyMatrix4f mv =
@@ -208,6 +310,10 @@ void update_camera(GLFWwindow* window, ShaderPrograms& programs) {
     float mv_array[16] = {0};
     mv.Get(mv_array);
     programs.mesh.SetUniformMatrix4("MV", mv_array);
+    programs.mesh.SetUniform("NearPlane", CAM_NEAR);
+    programs.mesh.SetUniform("FarPlane", CAM_FAR);
+
+    return finalTransform;
 }
 
 cyMatrix4f model_view(cyVec3f translation, float yaw, float pitch, float roll) {